@@ -3,7 +3,23 @@
 #include <string.h>
 #include <stdio.h>
 #include "devices/ide.h"
+#include "devices/timer.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Most requests, and buffers, that one transfer may merge. */
+#define BLOCK_MERGE_MAX 16
+#define MERGE_IOV_MAX 32
+
+/* Ticks after which a queued read or write, respectively, goes
+   ahead of requests that the elevator would otherwise prefer.
+   Reads usually have a thread waiting on them, so they expire
+   sooner. */
+#define READ_EXPIRE (TIMER_FREQ / 20)
+#define WRITE_EXPIRE (TIMER_FREQ / 2)
 
 /* A block device. */
 struct block
@@ -17,8 +33,16 @@ struct block
     const struct block_operations *ops;  /* Driver operations. */
     void *aux;                          /* Extra data owned by driver. */
 
-    unsigned long long read_cnt;        /* Number of sectors read. */
-    unsigned long long write_cnt;       /* Number of sectors written. */
+    struct block_stats stats;           /* Statistics, updated with
+                                           interrupts off. */
+
+    /* Request queue, served by the device's I/O thread.  Devices
+       that remap their requests to another device have none. */
+    struct list queue;                  /* Pending requests, by sector. */
+    struct lock queue_lock;             /* Protects queue. */
+    struct condition queue_nonempty;    /* Signaled on each submit. */
+    struct semaphore slot_free;         /* Up'd by block_complete(). */
+    block_sector_t head;                /* Sector after last transfer. */
   };
 
 /* List of all block devices. */
@@ -28,6 +52,8 @@ static struct list all_blocks = LIST_INITIALIZER (all_blocks);
 static struct block *block_by_role[BLOCK_ROLE_CNT];
 
 static struct block *list_elem_to_block (struct list_elem *);
+static list_less_func request_less;
+static thread_func io_thread;
 
 /* Returns a human-readable name for the given block device
    TYPE. */
@@ -113,6 +139,172 @@ check_sector (struct block *block, block_sector_t sector)
     }
 }
 
+/* Verifies that the CNT sectors starting at SECTOR all lie
+   within BLOCK.  Panics if not. */
+static void
+check_sectors (struct block *block, block_sector_t sector, size_t cnt)
+{
+  check_sector (block, sector);
+  if (cnt > block->size - sector)
+    PANIC ("Access past end of device %s (sector=%"PRDSNu", count=%zu, "
+           "size=%"PRDSNu")\n", block_name (block), sector, cnt, block->size);
+}
+
+/* Returns the total number of sectors in the IOV_CNT buffers in
+   IOV. */
+size_t
+block_iov_sectors (const struct block_iov *iov, size_t iov_cnt)
+{
+  size_t cnt = 0;
+  size_t i;
+
+  for (i = 0; i < iov_cnt; i++)
+    cnt += iov[i].sector_cnt;
+  return cnt;
+}
+
+/* Queues REQ, whose caller-owned members must be filled in, to
+   read or write sectors of BLOCK.  Returns at once; REQ->COMPLETE
+   is called once the transfer is done, from BLOCK's I/O thread
+   or from an interrupt handler, so it must not sleep.  REQ and
+   the buffers it names must stay valid until then, and the
+   buffers must be in kernel memory, since the I/O thread does
+   not run in any user address space.
+
+   Requests are not necessarily carried out in the order they
+   are submitted: each device's I/O thread sweeps across the
+   disk in ascending sector order (C-LOOK), merging requests for
+   adjacent sectors into a single transfer, except that a request
+   that has waited past its deadline goes first. */
+void
+block_submit (struct block *block, struct block_request *req)
+{
+  enum intr_level old_level;
+
+  req->sector_cnt = block_iov_sectors (req->iov, req->iov_cnt);
+  if (req->sector_cnt == 0)
+    {
+      req->complete (req);
+      return;
+    }
+  check_sectors (block, req->sector, req->sector_cnt);
+  ASSERT (!req->write || block->type != BLOCK_FOREIGN);
+  old_level = intr_disable ();
+  if (req->write)
+    block->stats.write_cnt += req->sector_cnt;
+  else
+    block->stats.read_cnt += req->sector_cnt;
+  intr_set_level (old_level);
+
+  /* Partitions and the like pass requests to the device beneath
+     them. */
+  if (block->ops->remap != NULL)
+    {
+      struct block *lower = block->ops->remap (block->aux, &req->sector);
+      block_submit (lower, req);
+      return;
+    }
+
+  req->deadline = timer_ticks () + (req->write ? WRITE_EXPIRE : READ_EXPIRE);
+  req->submit_time = timer_nsec ();
+  lock_acquire (&block->queue_lock);
+  list_insert_ordered (&block->queue, &req->elem, request_less, NULL);
+  cond_signal (&block->queue_nonempty, &block->queue_lock);
+  lock_release (&block->queue_lock);
+}
+
+/* Completion function for synchronous requests, whose AUX is a
+   semaphore to wake up. */
+static void
+complete_sync (struct block_request *req)
+{
+  sema_up (req->aux);
+}
+
+/* Submits a request to read from BLOCK, if WRITE is false, or
+   write to it, consecutive sectors starting at SECTOR, into or
+   from the IOV_CNT buffers in IOV, all of which must be kernel
+   memory, and waits for it to complete. */
+static void
+submit_sync (struct block *block, block_sector_t sector,
+             const struct block_iov *iov, size_t iov_cnt, bool write)
+{
+  struct block_request req;
+  struct semaphore done;
+
+  sema_init (&done, 0);
+  req.write = write;
+  req.sector = sector;
+  req.iov = iov;
+  req.iov_cnt = iov_cnt;
+  req.complete = complete_sync;
+  req.aux = &done;
+  block_submit (block, &req);
+  sema_down (&done);
+}
+
+/* Like submit_sync(), but for buffers that may be in user
+   memory.  The I/O thread that carries out requests does not run
+   in the caller's address space, so a user buffer is copied
+   through a kernel page, here in the caller's context, a page at
+   a time. */
+static void
+transfer_bounced (struct block *block, block_sector_t sector,
+                  const struct block_iov *iov, size_t iov_cnt, bool write)
+{
+  uint8_t *bounce = palloc_get_page (PAL_ASSERT);
+  size_t i;
+
+  for (i = 0; i < iov_cnt; sector += iov[i++].sector_cnt)
+    {
+      uint8_t *buffer = iov[i].buffer;
+      size_t done, cnt;
+
+      if (is_kernel_vaddr (buffer))
+        {
+          submit_sync (block, sector, &iov[i], 1, write);
+          continue;
+        }
+
+      for (done = 0; done < iov[i].sector_cnt; done += cnt)
+        {
+          struct block_iov page;
+          size_t ofs = done * BLOCK_SECTOR_SIZE;
+
+          cnt = iov[i].sector_cnt - done;
+          if (cnt > PGSIZE / BLOCK_SECTOR_SIZE)
+            cnt = PGSIZE / BLOCK_SECTOR_SIZE;
+          page.buffer = bounce;
+          page.sector_cnt = cnt;
+          if (write)
+            memcpy (bounce, buffer + ofs, cnt * BLOCK_SECTOR_SIZE);
+          submit_sync (block, sector + done, &page, 1, write);
+          if (!write)
+            memcpy (buffer + ofs, bounce, cnt * BLOCK_SECTOR_SIZE);
+        }
+    }
+  palloc_free_page (bounce);
+}
+
+/* Reads from BLOCK, if WRITE is false, or writes to it,
+   consecutive sectors starting at SECTOR, into or from the
+   IOV_CNT buffers in IOV, and waits for the transfer to
+   complete. */
+static void
+transfer_sync (struct block *block, block_sector_t sector,
+               const struct block_iov *iov, size_t iov_cnt, bool write)
+{
+  size_t i;
+
+  for (i = 0; i < iov_cnt; i++)
+    if (!is_kernel_vaddr (iov[i].buffer))
+      {
+        transfer_bounced (block, sector, iov, iov_cnt, write);
+        return;
+      }
+  submit_sync (block, sector, iov, iov_cnt, write);
+}
+
 /* Reads sector SECTOR from BLOCK into BUFFER, which must
    have room for BLOCK_SECTOR_SIZE bytes.
    Internally synchronizes accesses to block devices, so external
@@ -120,9 +312,7 @@ check_sector (struct block *block, block_sector_t sector)
 void
 block_read (struct block *block, block_sector_t sector, void *buffer)
 {
-  check_sector (block, sector);
-  block->ops->read (block->aux, sector, buffer);
-  block->read_cnt++;
+  block_read_multi (block, sector, 1, buffer);
 }
 
 /* Write sector SECTOR to BLOCK from BUFFER, which must contain
@@ -133,10 +323,320 @@ block_read (struct block *block, block_sector_t sector, void *buffer)
 void
 block_write (struct block *block, block_sector_t sector, const void *buffer)
 {
-  check_sector (block, sector);
-  ASSERT (block->type != BLOCK_FOREIGN);
-  block->ops->write (block->aux, sector, buffer);
-  block->write_cnt++;
+  block_write_multi (block, sector, 1, buffer);
+}
+
+/* Reads consecutive sectors from BLOCK, starting at SECTOR, into
+   the IOV_CNT buffers in IOV, filling each buffer in turn.
+   Drivers that support it transfer the whole run with as few
+   commands as possible; others fall back to one read per
+   sector.
+   Internally synchronizes accesses to block devices, so external
+   per-block device locking is unneeded. */
+void
+block_readv (struct block *block, block_sector_t sector,
+             const struct block_iov *iov, size_t iov_cnt)
+{
+  transfer_sync (block, sector, iov, iov_cnt, false);
+}
+
+/* Writes consecutive sectors to BLOCK, starting at SECTOR, from
+   the IOV_CNT buffers in IOV, taking each buffer in turn.
+   Returns after the block device has acknowledged receiving all
+   of the data.  Drivers that support it transfer the whole run
+   with as few commands as possible; others fall back to one
+   write per sector.
+   Internally synchronizes accesses to block devices, so external
+   per-block device locking is unneeded. */
+void
+block_writev (struct block *block, block_sector_t sector,
+              const struct block_iov *iov, size_t iov_cnt)
+{
+  transfer_sync (block, sector, iov, iov_cnt, true);
+}
+
+/* Reads the CNT sectors starting at SECTOR from BLOCK into
+   BUFFER, which must have room for CNT * BLOCK_SECTOR_SIZE
+   bytes. */
+void
+block_read_multi (struct block *block, block_sector_t sector, size_t cnt,
+                  void *buffer)
+{
+  struct block_iov iov;
+
+  iov.buffer = buffer;
+  iov.sector_cnt = cnt;
+  block_readv (block, sector, &iov, 1);
+}
+
+/* Writes the CNT sectors starting at SECTOR to BLOCK from
+   BUFFER, which must contain CNT * BLOCK_SECTOR_SIZE bytes. */
+void
+block_write_multi (struct block *block, block_sector_t sector, size_t cnt,
+                   const void *buffer)
+{
+  struct block_iov iov;
+
+  iov.buffer = (void *) buffer;
+  iov.sector_cnt = cnt;
+  block_writev (block, sector, &iov, 1);
+}
+
+/* Request scheduling. */
+
+/* Orders block requests by first sector. */
+static bool
+request_less (const struct list_elem *a_, const struct list_elem *b_,
+              void *aux UNUSED)
+{
+  const struct block_request *a = list_entry (a_, struct block_request, elem);
+  const struct block_request *b = list_entry (b_, struct block_request, elem);
+
+  return a->sector < b->sector;
+}
+
+/* Returns the request in BLOCK's queue, which must not be empty,
+   that should be carried out next: the one that is furthest
+   past its deadline, if any is; otherwise, the first at or after
+   the end of the last transfer, wrapping around to the lowest
+   sector at the end of each sweep. */
+static struct block_request *
+choose_request (struct block *block)
+{
+  int64_t now = timer_ticks ();
+  struct block_request *expired = NULL;
+  struct list_elem *e;
+
+  ASSERT (!list_empty (&block->queue));
+
+  for (e = list_begin (&block->queue); e != list_end (&block->queue);
+       e = list_next (e))
+    {
+      struct block_request *r = list_entry (e, struct block_request, elem);
+      if (r->deadline <= now
+          && (expired == NULL || r->deadline < expired->deadline))
+        expired = r;
+    }
+  if (expired != NULL)
+    return expired;
+
+  for (e = list_begin (&block->queue); e != list_end (&block->queue);
+       e = list_next (e))
+    {
+      struct block_request *r = list_entry (e, struct block_request, elem);
+      if (r->sector >= block->head)
+        return r;
+    }
+  return list_entry (list_front (&block->queue), struct block_request, elem);
+}
+
+/* Removes from BLOCK's queue the next request to carry out and,
+   following it, any requests in the same direction for the
+   sectors just after it, up to MAX_CNT requests in all and
+   MERGE_IOV_MAX buffers between them, storing them in BATCH in
+   order.  Returns the number of requests removed. */
+static size_t
+take_batch (struct block *block, struct block_request *batch[],
+            size_t max_cnt)
+{
+  struct block_request *first = choose_request (block);
+  size_t iov_cnt = first->iov_cnt;
+  size_t cnt = 0;
+  struct list_elem *e = &first->elem;
+  size_t depth = list_size (&block->queue);
+  enum intr_level old_level;
+  size_t i;
+
+  old_level = intr_disable ();
+  block->stats.depth_sum += depth;
+  if (depth > block->stats.max_depth)
+    block->stats.max_depth = depth;
+  intr_set_level (old_level);
+
+  batch[cnt++] = first;
+  while (cnt < max_cnt)
+    {
+      struct block_request *prev = batch[cnt - 1];
+      struct block_request *next;
+
+      e = list_next (e);
+      if (e == list_end (&block->queue))
+        break;
+      next = list_entry (e, struct block_request, elem);
+      if (next->write != first->write
+          || next->sector != prev->sector + prev->sector_cnt
+          || iov_cnt + next->iov_cnt > MERGE_IOV_MAX)
+        break;
+      iov_cnt += next->iov_cnt;
+      batch[cnt++] = next;
+    }
+
+  for (i = 0; i < cnt; i++)
+    list_remove (&batch[i]->elem);
+  return cnt;
+}
+
+/* Returns the latency histogram bucket for an interval of NSEC
+   nanoseconds. */
+static int
+log2_bucket (int64_t nsec)
+{
+  int bucket = 0;
+
+  while (nsec > 1 && bucket < BLOCK_HIST_BUCKETS - 1)
+    {
+      nsec >>= 1;
+      bucket++;
+    }
+  return bucket;
+}
+
+/* Records in BLOCK's statistics the start of a transfer of
+   SECTOR_CNT sectors starting at SECTOR. */
+static void
+note_transfer (struct block *block, block_sector_t sector, size_t sector_cnt)
+{
+  enum intr_level old_level = intr_disable ();
+  block->stats.transfer_cnt++;
+  if (sector == block->head)
+    block->stats.seq_cnt++;
+  block->head = sector + sector_cnt;
+  intr_set_level (old_level);
+}
+
+/* Records in BLOCK's statistics that REQ completed at time END,
+   in nanoseconds since boot. */
+static void
+note_completion (struct block *block, const struct block_request *req,
+                 int64_t end)
+{
+  enum intr_level old_level = intr_disable ();
+  block->stats.request_cnt++;
+  block->stats.wait_time += req->start_time - req->submit_time;
+  block->stats.service_time += end - req->start_time;
+  block->stats.latency[log2_bucket (end - req->submit_time)]++;
+  intr_set_level (old_level);
+}
+
+/* Carries out the CNT requests in BATCH, which are for
+   consecutive sectors of BLOCK in the same direction, as one
+   transfer, and then completes each of them. */
+static void
+dispatch_batch (struct block *block, struct block_request *batch[], size_t cnt)
+{
+  struct block_iov merged[MERGE_IOV_MAX];
+  const struct block_iov *iov;
+  size_t iov_cnt, i, j;
+  bool write = batch[0]->write;
+  block_sector_t sector = batch[0]->sector;
+  size_t sector_cnt = 0;
+  int64_t start, end;
+
+  if (cnt == 1)
+    {
+      iov = batch[0]->iov;
+      iov_cnt = batch[0]->iov_cnt;
+    }
+  else
+    {
+      iov_cnt = 0;
+      for (i = 0; i < cnt; i++)
+        for (j = 0; j < batch[i]->iov_cnt; j++)
+          merged[iov_cnt++] = batch[i]->iov[j];
+      iov = merged;
+    }
+  for (i = 0; i < cnt; i++)
+    sector_cnt += batch[i]->sector_cnt;
+
+  note_transfer (block, sector, sector_cnt);
+  start = timer_nsec ();
+  if (write && block->ops->writev != NULL)
+    block->ops->writev (block->aux, sector, iov, iov_cnt);
+  else if (!write && block->ops->readv != NULL)
+    block->ops->readv (block->aux, sector, iov, iov_cnt);
+  else
+    {
+      /* One sector at a time. */
+      block_sector_t s = sector;
+      for (i = 0; i < iov_cnt; i++)
+        for (j = 0; j < iov[i].sector_cnt; j++)
+          {
+            uint8_t *buffer = (uint8_t *) iov[i].buffer + j * BLOCK_SECTOR_SIZE;
+            if (write)
+              block->ops->write (block->aux, s++, buffer);
+            else
+              block->ops->read (block->aux, s++, buffer);
+          }
+    }
+  end = timer_nsec ();
+
+  for (i = 0; i < cnt; i++)
+    {
+      batch[i]->start_time = start;
+      note_completion (block, batch[i], end);
+      batch[i]->complete (batch[i]);
+    }
+}
+
+/* Hands REQ to BLOCK's driver, which must have a SUBMIT
+   operation, waiting for the driver to have room for it if
+   necessary.  The driver calls block_complete() once the
+   transfer is done. */
+static void
+dispatch_async (struct block *block, struct block_request *req)
+{
+  note_transfer (block, req->sector, req->sector_cnt);
+  req->device = block;
+  req->start_time = timer_nsec ();
+  while (!block->ops->submit (block->aux, req))
+    {
+      /* Every request that the driver completes ups SLOT_FREE,
+         so we can't sleep forever, though we may wake up to a
+         driver that is still full. */
+      sema_down (&block->slot_free);
+      req->start_time = timer_nsec ();
+    }
+}
+
+/* Called by a block device driver, possibly from an interrupt
+   handler, when it has finished carrying out REQ, which was
+   passed to its SUBMIT operation. */
+void
+block_complete (struct block_request *req)
+{
+  struct block *block = req->device;
+
+  note_completion (block, req, timer_nsec ());
+  sema_up (&block->slot_free);
+  req->complete (req);
+}
+
+/* A block device's I/O thread, which carries out the requests
+   in its queue, BLOCK_. */
+static void
+io_thread (void *block_)
+{
+  struct block *block = block_;
+
+  for (;;)
+    {
+      struct block_request *batch[BLOCK_MERGE_MAX];
+      size_t cnt;
+
+      /* Drivers that take requests asynchronously can keep many
+         in flight, so there is no need to merge them. */
+      lock_acquire (&block->queue_lock);
+      while (list_empty (&block->queue))
+        cond_wait (&block->queue_nonempty, &block->queue_lock);
+      cnt = take_batch (block, batch,
+                        block->ops->submit != NULL ? 1 : BLOCK_MERGE_MAX);
+      lock_release (&block->queue_lock);
+
+      if (block->ops->submit != NULL)
+        dispatch_async (block, batch[0]);
+      else
+        dispatch_batch (block, batch, cnt);
+    }
 }
 
 /* Returns the number of sectors in BLOCK. */
@@ -160,21 +660,74 @@ block_type (struct block *block)
   return block->type;
 }
 
-/* Prints statistics for each block device used for a Pintos role. */
+/* Copies BLOCK's I/O statistics into *STATS.  May be called at
+   any time, to watch the statistics change. */
 void
-block_print_stats (void)
+block_get_stats (struct block *block, struct block_stats *stats)
+{
+  enum intr_level old_level = intr_disable ();
+  *stats = block->stats;
+  intr_set_level (old_level);
+}
+
+/* Prints STATS, for a device with a request queue, in detail. */
+static void
+print_queue_stats (const struct block_stats *stats)
+{
+  unsigned long long n = stats->request_cnt;
+  unsigned long long t = stats->transfer_cnt;
+  int i;
+
+  if (n == 0 || t == 0)
+    return;
+  printf ("  %llu requests in %llu transfers, %llu%% sequential, "
+          "queue depth avg %llu.%02llu max %u\n",
+          n, t, stats->seq_cnt * 100 / t,
+          stats->depth_sum / t, stats->depth_sum * 100 / t % 100,
+          stats->max_depth);
+  printf ("  mean us per request: %"PRId64" queued, %"PRId64" in driver\n",
+          stats->wait_time / n / 1000, stats->service_time / n / 1000);
+  printf ("  latency histogram (ns):");
+  for (i = 0; i < BLOCK_HIST_BUCKETS; i++)
+    if (stats->latency[i] != 0)
+      printf (" 2^%d:%llu", i, stats->latency[i]);
+  printf ("\n");
+}
+
+/* Returns true if BLOCK has been assigned a Pintos role. */
+static bool
+has_role (const struct block *block)
 {
   int i;
 
   for (i = 0; i < BLOCK_ROLE_CNT; i++)
+    if (block_by_role[i] == block)
+      return true;
+  return false;
+}
+
+/* Prints statistics for each block device used for a Pintos role,
+   and for any other device that has been used, such as the disk
+   beneath a partition. */
+void
+block_print_stats (void)
+{
+  struct block *block;
+
+  for (block = block_first (); block != NULL; block = block_next (block))
     {
-      struct block *block = block_by_role[i];
-      if (block != NULL)
-        {
-          printf ("%s (%s): %llu reads, %llu writes\n",
-                  block->name, block_type_name (block->type),
-                  block->read_cnt, block->write_cnt);
-        }
+      struct block_stats stats;
+
+      block_get_stats (block, &stats);
+      if (!has_role (block) && stats.read_cnt == 0 && stats.write_cnt == 0)
+        continue;
+      printf ("%s (%s): %llu reads, %llu writes (%llu kB read, "
+              "%llu kB written)\n",
+              block->name, block_type_name (block->type),
+              stats.read_cnt, stats.write_cnt,
+              stats.read_cnt * BLOCK_SECTOR_SIZE / 1024,
+              stats.write_cnt * BLOCK_SECTOR_SIZE / 1024);
+      print_queue_stats (&stats);
     }
 }
 
@@ -182,7 +735,9 @@ block_print_stats (void)
    EXTRA_INFO is non-null, it is printed as part of a user
    message.  The block device's SIZE in sectors and its TYPE must
    be provided, as well as the it operation functions OPS, which
-   will be passed AUX in each function call. */
+   will be passed AUX in each function call.  Unless OPS remaps
+   requests to another device, starts an I/O thread to serve the
+   new device's request queue. */
 struct block *
 block_register (const char *name, enum block_type type,
                 const char *extra_info, block_sector_t size,
@@ -198,8 +753,18 @@ block_register (const char *name, enum block_type type,
   block->size = size;
   block->ops = ops;
   block->aux = aux;
-  block->read_cnt = 0;
-  block->write_cnt = 0;
+  memset (&block->stats, 0, sizeof block->stats);
+  list_init (&block->queue);
+  lock_init (&block->queue_lock);
+  cond_init (&block->queue_nonempty);
+  sema_init (&block->slot_free, 0);
+  block->head = 0;
+  if (ops->remap == NULL)
+    {
+      char thread_name[sizeof block->name + 3];
+      snprintf (thread_name, sizeof thread_name, "%s-io", block->name);
+      thread_create (thread_name, PRI_MAX, io_thread, block);
+    }
 
   printf ("%s: %'"PRDSNu" sectors (", block->name, block->size);
   print_human_readable_size ((uint64_t) block->size * BLOCK_SECTOR_SIZE);
@@ -1,6 +1,8 @@
 #ifndef DEVICES_BLOCK_H
 #define DEVICES_BLOCK_H
 
+#include <list.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <inttypes.h>
 
@@ -49,14 +51,82 @@ struct block *block_get_by_name (const char *name);
 struct block *block_first (void);
 struct block *block_next (struct block *);
 
+/* One buffer of a vectored transfer: SECTOR_CNT consecutive
+   sectors' worth of data at BUFFER. */
+struct block_iov
+  {
+    void *buffer;               /* SECTOR_CNT * BLOCK_SECTOR_SIZE bytes. */
+    size_t sector_cnt;          /* Number of sectors. */
+  };
+
+size_t block_iov_sectors (const struct block_iov *, size_t iov_cnt);
+
+/* An asynchronous request to read or write a run of consecutive
+   sectors. */
+struct block_request
+  {
+    /* Filled in by the submitter. */
+    bool write;                 /* Write to the device, or read? */
+    block_sector_t sector;      /* First sector. */
+    const struct block_iov *iov;        /* Buffers, in order. */
+    size_t iov_cnt;             /* Number of buffers. */
+    void (*complete) (struct block_request *);  /* Called when done. */
+    void *aux;                  /* For use by COMPLETE. */
+
+    /* Owned by the block layer. */
+    struct list_elem elem;      /* Element in device queue. */
+    size_t sector_cnt;          /* Sectors in IOV. */
+    int64_t deadline;           /* Timer tick by which to start. */
+    int64_t submit_time;        /* timer_nsec() when queued. */
+    int64_t start_time;         /* timer_nsec() when sent to driver. */
+    struct block *device;       /* Device whose driver has it. */
+  };
+
 /* Block device operations. */
 block_sector_t block_size (struct block *);
 void block_read (struct block *, block_sector_t, void *);
 void block_write (struct block *, block_sector_t, const void *);
+void block_readv (struct block *, block_sector_t,
+                  const struct block_iov *, size_t iov_cnt);
+void block_writev (struct block *, block_sector_t,
+                   const struct block_iov *, size_t iov_cnt);
+void block_read_multi (struct block *, block_sector_t, size_t cnt, void *);
+void block_write_multi (struct block *, block_sector_t, size_t cnt,
+                        const void *);
+void block_submit (struct block *, struct block_request *);
 const char *block_name (struct block *);
 enum block_type block_type (struct block *);
 
 /* Statistics. */
+
+/* Number of buckets in a latency histogram.  Bucket I counts
+   requests that took from 2**I up to 2**(I+1) nanoseconds. */
+#define BLOCK_HIST_BUCKETS 40
+
+/* I/O statistics for a block device.  Sector counts include
+   requests to its partitions; timing and queueing figures are
+   kept only by devices with a request queue of their own. */
+struct block_stats
+  {
+    unsigned long long read_cnt;        /* Number of sectors read. */
+    unsigned long long write_cnt;       /* Number of sectors written. */
+
+    unsigned long long request_cnt;     /* Requests completed. */
+    unsigned long long transfer_cnt;    /* Driver transfers, after merging. */
+    unsigned long long seq_cnt;         /* Transfers starting where the
+                                           previous one ended. */
+    unsigned long long depth_sum;       /* Sum of queue depth at each
+                                           transfer. */
+    unsigned max_depth;                 /* Greatest queue depth seen. */
+
+    int64_t wait_time;                  /* Total ns spent queued. */
+    int64_t service_time;               /* Total ns in the driver. */
+    unsigned long long latency[BLOCK_HIST_BUCKETS]; /* Requests by log2
+                                           of ns from submission
+                                           to completion. */
+  };
+
+void block_get_stats (struct block *, struct block_stats *);
 void block_print_stats (void);
 
 /* Lower-level interface to block device drivers. */
@@ -65,10 +135,35 @@ struct block_operations
   {
     void (*read) (void *aux, block_sector_t, void *buffer);
     void (*write) (void *aux, block_sector_t, const void *buffer);
+
+    /* Optional.  Transfer a run of consecutive sectors, starting
+       at the given sector, into or out of the buffers in an array
+       of block_iov.  If null, the run is transferred one sector
+       at a time with READ or WRITE. */
+    void (*readv) (void *aux, block_sector_t,
+                   const struct block_iov *, size_t iov_cnt);
+    void (*writev) (void *aux, block_sector_t,
+                    const struct block_iov *, size_t iov_cnt);
+
+    /* Optional.  For a device that is a window onto another
+       device, such as a partition: returns the other device and
+       converts the sector passed in to the other device's
+       numbering.  Requests then go to the other device's queue,
+       and none of the operations above is ever called. */
+    struct block *(*remap) (void *aux, block_sector_t *);
+
+    /* Optional.  Starts carrying out a request and returns true,
+       or returns false if the device has no room for another
+       request right now.  The driver calls block_complete() when
+       the request is done, perhaps from an interrupt handler.
+       Lets a device have many requests in flight at once; if
+       present, none of READ, WRITE, READV and WRITEV is called. */
+    bool (*submit) (void *aux, struct block_request *);
   };
 
 struct block *block_register (const char *name, enum block_type,
                               const char *extra_info, block_sector_t size,
                               const struct block_operations *, void *aux);
+void block_complete (struct block_request *);
 
 #endif /* devices/block.h */
@@ -3,12 +3,16 @@
 #include <debug.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 #include "devices/block.h"
 #include "devices/partition.h"
+#include "devices/pci.h"
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
+#include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/vaddr.h"
 
 /* The code in this file is an interface to an ATA (IDE)
    controller.  It attempts to comply to [ATA-3]. */
@@ -34,6 +38,7 @@
 #define STA_BSY 0x80            /* Busy. */
 #define STA_DRDY 0x40           /* Device Ready. */
 #define STA_DRQ 0x08            /* Data Request. */
+#define STA_ERR 0x01            /* Error. */
 
 /* Control Register bits. */
 #define CTL_SRST 0x04           /* Software Reset. */
@@ -49,6 +54,41 @@
 #define CMD_IDENTIFY_DEVICE 0xec        /* IDENTIFY DEVICE. */
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
+#define CMD_READ_DMA 0xc8               /* READ DMA. */
+#define CMD_WRITE_DMA 0xca              /* WRITE DMA. */
+
+/* PCI bus master IDE port addresses, relative to the bus master
+   base of a channel.  See [IDE-DMA]. */
+#define reg_bm_command(CHANNEL) ((CHANNEL)->bm_base + 0)  /* Command. */
+#define reg_bm_status(CHANNEL) ((CHANNEL)->bm_base + 2)   /* Status. */
+#define reg_bm_prdt(CHANNEL) ((CHANNEL)->bm_base + 4)     /* PRD table. */
+
+/* Bus master Command Register bits. */
+#define BM_CMD_START 0x01       /* Start transfer. */
+#define BM_CMD_READ 0x08        /* Transfer from disk to memory. */
+
+/* Bus master Status Register bits. */
+#define BM_STA_ERR 0x02         /* Error, write 1 to clear. */
+#define BM_STA_INTR 0x04        /* Interrupt, write 1 to clear. */
+
+/* A physical region descriptor, one entry in a PRD table, which
+   tells the bus master where in memory a DMA transfer goes. */
+struct prd
+  {
+    uint32_t addr;              /* Physical address, must be even. */
+    uint16_t size;              /* Byte count, 0 meaning 64 kB. */
+    uint16_t flags;             /* PRD_EOT on the last entry. */
+  };
+#define PRD_EOT 0x8000          /* End of table. */
+
+/* A PRD table lives in one page, and no region may cross a
+   64 kB boundary. */
+#define PRD_CNT (PGSIZE / sizeof (struct prd))
+#define PRD_BOUNDARY 0x10000
+
+/* Most sectors that one READ or WRITE SECTOR command can
+   transfer. */
+#define MAX_CMD_SECTORS 256
 
 /* An ATA device. */
 struct ata_disk
@@ -57,6 +97,7 @@ struct ata_disk
     struct channel *channel;    /* Channel that disk is attached to. */
     int dev_no;                 /* Device 0 or 1 for master or slave. */
     bool is_ata;                /* Is device an ATA disk? */
+    bool dma;                   /* Use bus master DMA for transfers? */
   };
 
 /* An ATA channel (aka controller).
@@ -72,6 +113,9 @@ struct channel
                                    any interrupt would be spurious. */
     struct semaphore completion_wait;   /* Up'd by interrupt handler. */
 
+    uint16_t bm_base;           /* Bus master base I/O port, 0 if none. */
+    struct prd *prdt;           /* PRD table, if bm_base is nonzero. */
+
     struct ata_disk devices[2];     /* The devices on this channel. */
   };
 
@@ -81,11 +125,12 @@ static struct channel channels[CHANNEL_CNT];
 
 static struct block_operations ide_operations;
 
+static void find_bus_master (void);
 static void reset_channel (struct channel *);
 static bool check_device_type (struct ata_disk *);
 static void identify_ata_device (struct ata_disk *);
 
-static void select_sector (struct ata_disk *, block_sector_t);
+static void select_sector (struct ata_disk *, block_sector_t, size_t cnt);
 static void issue_pio_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
@@ -95,6 +140,10 @@ static bool wait_while_busy (const struct ata_disk *);
 static void select_device (const struct ata_disk *);
 static void select_device_wait (const struct ata_disk *);
 
+static bool dma_transfer (struct ata_disk *, block_sector_t,
+                          const struct block_iov *, size_t iov_cnt,
+                          bool write);
+
 static void interrupt_handler (struct intr_frame *);
 
 /* Initialize the disk subsystem and detect disks. */
@@ -103,6 +152,7 @@ ide_init (void)
 {
   size_t chan_no;
 
+  find_bus_master ();
   for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
     {
       struct channel *c = &channels[chan_no];
@@ -126,6 +176,8 @@ ide_init (void)
       lock_init (&c->lock);
       c->expecting_interrupt = false;
       sema_init (&c->completion_wait, 0);
+      c->bm_base = 0;
+      c->prdt = NULL;
  
       /* Initialize devices. */
       for (dev_no = 0; dev_no < 2; dev_no++)
@@ -136,6 +188,7 @@ ide_init (void)
           d->channel = c;
           d->dev_no = dev_no;
           d->is_ata = false;
+          d->dma = false;
         }
 
       /* Register interrupt handler. */
@@ -159,6 +212,37 @@ ide_init (void)
 
 static char *descramble_ata_string (char *, int size);
 
+/* Looks for a PCI IDE controller that can act as a bus master
+   for the legacy channels and, if there is one, sets up each
+   channel to use it for DMA. */
+static void
+find_bus_master (void)
+{
+  struct pci_device dev;
+  uint16_t bm_base;
+  size_t chan_no;
+
+  /* Bit 7 of the programming interface says that the controller
+     can master the bus; its registers are in I/O BAR 4. */
+  if (!pci_find_class (0x01, 0x01, &dev) || (dev.prog_if & 0x80) == 0)
+    return;
+  bm_base = pci_io_base (&dev, 4);
+  if (bm_base == 0)
+    return;
+  pci_enable_bus_master (&dev);
+
+  for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
+    {
+      struct channel *c = &channels[chan_no];
+      c->prdt = palloc_get_page (0);
+      if (c->prdt == NULL)
+        continue;
+      c->bm_base = bm_base + 8 * chan_no;
+      outb (reg_bm_command (c), 0);
+      outb (reg_bm_status (c), BM_STA_ERR | BM_STA_INTR);
+    }
+}
+
 /* Resets an ATA channel and waits for any devices present on it
    to finish the reset. */
 static void
@@ -303,6 +387,12 @@ identify_ata_device (struct ata_disk *d)
       return;
     }
 
+  /* Use DMA if the disk supports it (word 49, bit 8) and its
+     channel has a bus master. */
+  d->dma = c->bm_base != 0 && (*(uint16_t *) &id[49 * 2] & 0x100) != 0;
+  if (d->dma)
+    strlcat (extra_info, ", DMA", sizeof extra_info);
+
   /* Register. */
   block = block_register (d->name, BLOCK_RAW, extra_info, capacity,
                           &ide_operations, d);
@@ -337,63 +427,143 @@ descramble_ata_string (char *string, int size)
   return string;
 }
 
-/* Reads sector SEC_NO from disk D into BUFFER, which must have
-   room for BLOCK_SECTOR_SIZE bytes.
+/* Reads consecutive sectors, starting at SEC_NO, from disk D
+   into the IOV_CNT buffers in IOV.  Uses DMA if possible.
+   Otherwise, each READ SECTOR command transfers up to
+   MAX_CMD_SECTORS sectors by PIO, the disk interrupting once as
+   each sector becomes ready.
    Internally synchronizes accesses to disks, so external
    per-disk locking is unneeded. */
 static void
-ide_read (void *d_, block_sector_t sec_no, void *buffer)
+ide_readv (void *d_, block_sector_t sec_no,
+           const struct block_iov *iov, size_t iov_cnt)
 {
   struct ata_disk *d = d_;
   struct channel *c = d->channel;
+  size_t left = block_iov_sectors (iov, iov_cnt);
+  size_t cmd_left = 0;
+  size_t i, j;
+
+  if (dma_transfer (d, sec_no, iov, iov_cnt, false))
+    return;
+
   lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-  sema_down (&c->completion_wait);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
-  input_sector (c, buffer);
+  for (i = 0; i < iov_cnt; i++)
+    for (j = 0; j < iov[i].sector_cnt; j++)
+      {
+        if (cmd_left == 0)
+          {
+            cmd_left = left < MAX_CMD_SECTORS ? left : MAX_CMD_SECTORS;
+            select_sector (d, sec_no, cmd_left);
+            issue_pio_command (c, CMD_READ_SECTOR_RETRY);
+            sec_no += cmd_left;
+            left -= cmd_left;
+          }
+        sema_down (&c->completion_wait);
+        if (!wait_while_busy (d))
+          PANIC ("%s: disk read failed, sector=%"PRDSNu,
+                 d->name, sec_no - cmd_left);
+        input_sector (c, (uint8_t *) iov[i].buffer + j * BLOCK_SECTOR_SIZE);
+        cmd_left--;
+      }
   lock_release (&c->lock);
 }
 
-/* Write sector SEC_NO to disk D from BUFFER, which must contain
-   BLOCK_SECTOR_SIZE bytes.  Returns after the disk has
-   acknowledged receiving the data.
+/* Writes consecutive sectors, starting at SEC_NO, to disk D from
+   the IOV_CNT buffers in IOV.  Uses DMA if possible.  Otherwise,
+   each WRITE SECTOR command transfers up to MAX_CMD_SECTORS
+   sectors by PIO, the disk interrupting once as it accepts each
+   sector.  Returns after the disk has acknowledged receiving all
+   of the data.
    Internally synchronizes accesses to disks, so external
    per-disk locking is unneeded. */
 static void
-ide_write (void *d_, block_sector_t sec_no, const void *buffer)
+ide_writev (void *d_, block_sector_t sec_no,
+            const struct block_iov *iov, size_t iov_cnt)
 {
   struct ata_disk *d = d_;
   struct channel *c = d->channel;
+  size_t left = block_iov_sectors (iov, iov_cnt);
+  size_t cmd_left = 0;
+  size_t i, j;
+
+  if (dma_transfer (d, sec_no, iov, iov_cnt, true))
+    return;
+
   lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
-  output_sector (c, buffer);
-  sema_down (&c->completion_wait);
+  for (i = 0; i < iov_cnt; i++)
+    for (j = 0; j < iov[i].sector_cnt; j++)
+      {
+        if (cmd_left == 0)
+          {
+            cmd_left = left < MAX_CMD_SECTORS ? left : MAX_CMD_SECTORS;
+            select_sector (d, sec_no, cmd_left);
+            issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
+            sec_no += cmd_left;
+            left -= cmd_left;
+          }
+        if (!wait_while_busy (d))
+          PANIC ("%s: disk write failed, sector=%"PRDSNu,
+                 d->name, sec_no - cmd_left);
+        output_sector (c, (uint8_t *) iov[i].buffer + j * BLOCK_SECTOR_SIZE);
+        sema_down (&c->completion_wait);
+        cmd_left--;
+      }
   lock_release (&c->lock);
 }
 
+/* Reads sector SEC_NO from disk D into BUFFER, which must have
+   room for BLOCK_SECTOR_SIZE bytes.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+static void
+ide_read (void *d, block_sector_t sec_no, void *buffer)
+{
+  struct block_iov iov;
+
+  iov.buffer = buffer;
+  iov.sector_cnt = 1;
+  ide_readv (d, sec_no, &iov, 1);
+}
+
+/* Write sector SEC_NO to disk D from BUFFER, which must contain
+   BLOCK_SECTOR_SIZE bytes.  Returns after the disk has
+   acknowledged receiving the data.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+static void
+ide_write (void *d, block_sector_t sec_no, const void *buffer)
+{
+  struct block_iov iov;
+
+  iov.buffer = (void *) buffer;
+  iov.sector_cnt = 1;
+  ide_writev (d, sec_no, &iov, 1);
+}
+
 static struct block_operations ide_operations =
   {
     ide_read,
-    ide_write
+    ide_write,
+    ide_readv,
+    ide_writev,
+    NULL,
+    NULL
   };
 
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+   writes SEC_NO and the number of sectors to transfer, CNT, to
+   the disk's sector selection registers.  (We use LBA mode.) */
 static void
-select_sector (struct ata_disk *d, block_sector_t sec_no)
+select_sector (struct ata_disk *d, block_sector_t sec_no, size_t cnt)
 {
   struct channel *c = d->channel;
 
   ASSERT (sec_no < (1UL << 28));
+  ASSERT (cnt > 0 && cnt <= MAX_CMD_SECTORS);
   
   select_device_wait (d);
-  outb (reg_nsect (c), 1);
+  outb (reg_nsect (c), cnt);    /* 256 wraps to 0, which means 256. */
   outb (reg_lbal (c), sec_no);
   outb (reg_lbam (c), sec_no >> 8);
   outb (reg_lbah (c), (sec_no >> 16));
@@ -401,6 +571,113 @@ select_sector (struct ata_disk *d, block_sector_t sec_no)
         DEV_MBS | DEV_LBA | (d->dev_no == 1 ? DEV_DEV : 0) | (sec_no >> 24));
 }
 
+/* Bus master DMA. */
+
+/* Appends to C's PRD table, whose first *PRD_CNT entries are in
+   use, entries describing the SIZE bytes of kernel memory at
+   BUFFER. */
+static void
+add_prds (struct channel *c, size_t *prd_cnt, const uint8_t *buffer,
+          size_t size)
+{
+  /* Kernel virtual memory maps physical memory contiguously, so
+     BUFFER is physically contiguous too. */
+  uintptr_t addr = vtop (buffer);
+
+  while (size > 0)
+    {
+      size_t chunk = PRD_BOUNDARY - addr % PRD_BOUNDARY;
+      struct prd *prd;
+
+      if (chunk > size)
+        chunk = size;
+      ASSERT (*prd_cnt < PRD_CNT);
+      prd = &c->prdt[(*prd_cnt)++];
+      prd->addr = addr;
+      prd->size = chunk;        /* 64 kB wraps to 0, as it should. */
+      prd->flags = 0;
+      addr += chunk;
+      size -= chunk;
+    }
+}
+
+/* Transfers consecutive sectors, starting at SEC_NO, between
+   disk D and the IOV_CNT buffers in IOV, using bus master DMA:
+   reads from D if WRITE is false, otherwise writes to it.  Each
+   READ or WRITE DMA command moves up to MAX_CMD_SECTORS sectors
+   while the CPU is free to run other threads, and raises a
+   single interrupt on completion.
+   Returns false, without doing anything, if D or IOV is not
+   suitable for DMA, in which case the caller should use PIO. */
+static bool
+dma_transfer (struct ata_disk *d, block_sector_t sec_no,
+              const struct block_iov *iov, size_t iov_cnt, bool write)
+{
+  struct channel *c = d->channel;
+  size_t left = block_iov_sectors (iov, iov_cnt);
+  size_t i, j;
+
+  if (!d->dma)
+    return false;
+  for (i = 0; i < iov_cnt; i++)
+    if (!is_kernel_vaddr (iov[i].buffer) || (uintptr_t) iov[i].buffer % 2)
+      return false;
+
+  lock_acquire (&c->lock);
+  i = j = 0;
+  while (left > 0)
+    {
+      size_t cmd_cnt = left < MAX_CMD_SECTORS ? left : MAX_CMD_SECTORS;
+      size_t prd_cnt = 0;
+      size_t need = cmd_cnt;
+      uint8_t bm_status;
+
+      /* Describe the next CMD_CNT sectors of IOV, starting at
+         sector J of buffer I, in the PRD table. */
+      while (need > 0)
+        {
+          size_t run = iov[i].sector_cnt - j;
+          if (run > need)
+            run = need;
+          add_prds (c, &prd_cnt,
+                    (uint8_t *) iov[i].buffer + j * BLOCK_SECTOR_SIZE,
+                    run * BLOCK_SECTOR_SIZE);
+          need -= run;
+          j += run;
+          if (j == iov[i].sector_cnt)
+            {
+              i++;
+              j = 0;
+            }
+        }
+      c->prdt[prd_cnt - 1].flags = PRD_EOT;
+
+      /* Program the bus master, then the disk, then start. */
+      outl (reg_bm_prdt (c), vtop (c->prdt));
+      outb (reg_bm_command (c), write ? 0 : BM_CMD_READ);
+      outb (reg_bm_status (c), BM_STA_ERR | BM_STA_INTR);
+      select_sector (d, sec_no, cmd_cnt);
+      issue_pio_command (c, write ? CMD_WRITE_DMA : CMD_READ_DMA);
+      outb (reg_bm_command (c), (write ? 0 : BM_CMD_READ) | BM_CMD_START);
+
+      /* Wait for the completion interrupt, then stop the bus
+         master and check for errors. */
+      sema_down (&c->completion_wait);
+      outb (reg_bm_command (c), write ? 0 : BM_CMD_READ);
+      bm_status = inb (reg_bm_status (c));
+      outb (reg_bm_status (c), BM_STA_ERR | BM_STA_INTR);
+      if ((bm_status & BM_STA_ERR) != 0
+          || (inb (reg_alt_status (c)) & STA_ERR) != 0)
+        PANIC ("%s: disk %s failed, sector=%"PRDSNu,
+               d->name, write ? "write" : "read", sec_no);
+
+      sec_no += cmd_cnt;
+      left -= cmd_cnt;
+    }
+  lock_release (&c->lock);
+  return true;
+}
+
 /* Writes COMMAND to channel C and prepares for receiving a
    completion interrupt. */
 static void
@@ -4,13 +4,15 @@
 #include "devices/serial.h"
 
 /* Stores keys from the keyboard and serial port. */
+#define INPUT_BUFSIZE 64
 static struct intq buffer;
+static uint8_t buffer_space[INPUT_BUFSIZE];
 
 /* Initializes the input buffer. */
 void
 input_init (void) 
 {
-  intq_init (&buffer);
+  intq_init (&buffer, buffer_space, sizeof buffer_space);
 }
 
 /* Adds a key to the input buffer.
@@ -26,7 +28,8 @@ input_putc (uint8_t key)
 }
 
 /* Retrieves a key from the input buffer.
-   If the buffer is empty, waits for a key to be pressed. */
+   If the buffer is empty, waits for a key to be pressed, or
+   returns 0 if the current thread is killed meanwhile. */
 uint8_t
 input_getc (void) 
 {
@@ -41,6 +44,25 @@ input_getc (void)
   return key;
 }
 
+/* Retrieves up to SIZE keys from the input buffer into BUF and
+   returns the number retrieved.  If the buffer is empty, waits
+   for a key to be pressed, unless SIZE is 0 or the current thread
+   is killed meanwhile (see thread_kill()), in which case it
+   returns 0. */
+size_t
+input_read (void *buf, size_t size) 
+{
+  enum intr_level old_level;
+  size_t cnt;
+
+  old_level = intr_disable ();
+  cnt = intq_read (&buffer, buf, size);
+  serial_notify ();
+  intr_set_level (old_level);
+
+  return cnt;
+}
+
 /* Returns true if the input buffer is full,
    false otherwise.
    Interrupts must be off. */
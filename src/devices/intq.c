@@ -1,17 +1,24 @@
 #include "devices/intq.h"
 #include <debug.h>
+#include <string.h>
 #include "threads/thread.h"
 
-static int next (int pos);
-static void wait (struct intq *q, struct thread **waiter);
-static void signal (struct intq *q, struct thread **waiter);
+static size_t next (const struct intq *q, size_t pos);
+static bool wait (struct intq *q, struct list *waiters, bool killable);
+static void signal (struct intq *q, struct list *waiters);
 
-/* Initializes interrupt queue Q. */
+/* Initializes interrupt queue Q to use the SIZE bytes at BUF,
+   which must stay allocated as long as Q is in use.  Q can hold
+   one byte less than SIZE. */
 void
-intq_init (struct intq *q) 
+intq_init (struct intq *q, uint8_t *buf, size_t size) 
 {
-  lock_init (&q->lock);
-  q->not_full = q->not_empty = NULL;
+  ASSERT (size >= 2);
+
+  list_init (&q->not_full);
+  list_init (&q->not_empty);
+  q->buf = buf;
+  q->size = size;
   q->head = q->tail = 0;
 }
 
@@ -28,29 +35,36 @@ bool
 intq_full (const struct intq *q) 
 {
   ASSERT (intr_get_level () == INTR_OFF);
-  return next (q->head) == q->tail;
+  return next (q, q->head) == q->tail;
+}
+
+/* Returns the number of bytes in Q. */
+size_t
+intq_cnt (const struct intq *q) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  return (q->head + q->size - q->tail) % q->size;
+}
+
+/* Returns the number of bytes that may be added to Q before it
+   is full. */
+size_t
+intq_room (const struct intq *q) 
+{
+  return q->size - 1 - intq_cnt (q);
 }
 
 /* Removes a byte from Q and returns it.
-   If Q is empty, sleeps until a byte is added.
+   If Q is empty, sleeps until a byte is added, or returns 0 if
+   the current thread is killed meanwhile (see thread_kill()).
    When called from an interrupt handler, Q must not be empty. */
 uint8_t
 intq_getc (struct intq *q) 
 {
   uint8_t byte;
-  
-  ASSERT (intr_get_level () == INTR_OFF);
-  while (intq_empty (q)) 
-    {
-      ASSERT (!intr_context ());
-      lock_acquire (&q->lock);
-      wait (q, &q->not_empty);
-      lock_release (&q->lock);
-    }
-  
-  byte = q->buf[q->tail];
-  q->tail = next (q->tail);
-  signal (q, &q->not_full);
+
+  if (intq_read (q, &byte, 1) == 0)
+    return 0;
   return byte;
 }
 
@@ -60,55 +74,122 @@ intq_getc (struct intq *q)
 void
 intq_putc (struct intq *q, uint8_t byte) 
 {
+  intq_write (q, &byte, 1);
+}
+
+/* Removes up to MAX bytes from Q into BUFFER and returns the
+   number removed, which is at least 1 if MAX is nonzero.  If Q
+   is empty, sleeps until a byte is added, or returns 0 if the
+   current thread is killed meanwhile (see thread_kill()).  When
+   called from an interrupt handler, Q must not be empty. */
+size_t
+intq_read (struct intq *q, void *buffer_, size_t max) 
+{
+  uint8_t *buffer = buffer_;
+  size_t cnt, chunk;
+
   ASSERT (intr_get_level () == INTR_OFF);
-  while (intq_full (q))
+  if (max == 0)
+    return 0;
+  while (intq_empty (q)) 
     {
       ASSERT (!intr_context ());
-      lock_acquire (&q->lock);
-      wait (q, &q->not_full);
-      lock_release (&q->lock);
+      if (!wait (q, &q->not_empty, true))
+        return 0;
     }
 
-  q->buf[q->head] = byte;
-  q->head = next (q->head);
-  signal (q, &q->not_empty);
+  /* Copy out the bytes up to the end of the buffer, then any
+     that wrapped around to its start. */
+  cnt = intq_cnt (q);
+  if (cnt > max)
+    cnt = max;
+  chunk = q->size - q->tail;
+  if (chunk > cnt)
+    chunk = cnt;
+  memcpy (buffer, q->buf + q->tail, chunk);
+  memcpy (buffer + chunk, q->buf, cnt - chunk);
+  q->tail = (q->tail + cnt) % q->size;
+
+  signal (q, &q->not_full);
+  return cnt;
+}
+
+/* Adds the CNT bytes in BUFFER to the end of Q.  If Q fills up,
+   sleeps until bytes are removed, as many times as necessary.
+   When called from an interrupt handler, Q must have room for
+   all CNT bytes. */
+void
+intq_write (struct intq *q, const void *buffer_, size_t cnt) 
+{
+  const uint8_t *buffer = buffer_;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  while (cnt > 0)
+    {
+      size_t room, chunk;
+
+      while (intq_full (q))
+        {
+          ASSERT (!intr_context ());
+          wait (q, &q->not_full, false);
+        }
+
+      room = intq_room (q);
+      if (room > cnt)
+        room = cnt;
+      chunk = q->size - q->head;
+      if (chunk > room)
+        chunk = room;
+      memcpy (q->buf + q->head, buffer, chunk);
+      memcpy (q->buf, buffer + chunk, room - chunk);
+      q->head = (q->head + room) % q->size;
+      buffer += room;
+      cnt -= room;
+
+      signal (q, &q->not_empty);
+    }
 }
-
-/* Returns the position after POS within an intq. */
-static int
-next (int pos) 
+
+/* Returns the position after POS within Q. */
+static size_t
+next (const struct intq *q, size_t pos) 
 {
-  return (pos + 1) % INTQ_BUFSIZE;
+  return (pos + 1) % q->size;
 }
 
-/* WAITER must be the address of Q's not_empty or not_full
-   member.  Waits until the given condition is true. */
-static void
-wait (struct intq *q UNUSED, struct thread **waiter) 
+/* WAITERS must be Q's not_empty or not_full member.  Waits
+   until the given condition is true.  If KILLABLE, gives up if
+   the current thread is killed, and returns false; otherwise,
+   returns true. */
+static bool
+wait (struct intq *q UNUSED, struct list *waiters, bool killable) 
 {
   ASSERT (!intr_context ());
   ASSERT (intr_get_level () == INTR_OFF);
-  ASSERT ((waiter == &q->not_empty && intq_empty (q))
-          || (waiter == &q->not_full && intq_full (q)));
+  ASSERT ((waiters == &q->not_empty && intq_empty (q))
+          || (waiters == &q->not_full && intq_full (q)));
 
-  *waiter = thread_current ();
+  list_push_back (waiters, &thread_current ()->elem);
+  if (killable)
+    return thread_block_killable ();
   thread_block ();
+  return true;
 }
 
-/* WAITER must be the address of Q's not_empty or not_full
-   member, and the associated condition must be true.  If a
-   thread is waiting for the condition, wakes it up and resets
-   the waiting thread. */
+/* WAITERS must be Q's not_empty or not_full member, and the
+   associated condition must be true.  Wakes up every thread
+   waiting for the condition.  Each one checks the condition
+   again when it runs, since others may have got there first,
+   and a bulk transfer may have made room for, or brought data
+   for, more than one of them. */
 static void
-signal (struct intq *q UNUSED, struct thread **waiter) 
+signal (struct intq *q UNUSED, struct list *waiters) 
 {
   ASSERT (intr_get_level () == INTR_OFF);
-  ASSERT ((waiter == &q->not_empty && !intq_empty (q))
-          || (waiter == &q->not_full && !intq_full (q)));
+  ASSERT ((waiters == &q->not_empty && !intq_empty (q))
+          || (waiters == &q->not_full && !intq_full (q)));
 
-  if (*waiter != NULL) 
-    {
-      thread_unblock (*waiter);
-      *waiter = NULL;
-    }
+  while (!list_empty (waiters))
+    thread_unblock (list_entry (list_pop_front (waiters),
+                                struct thread, elem));
 }
@@ -1,8 +1,9 @@
 #ifndef DEVICES_INTQ_H
 #define DEVICES_INTQ_H
 
+#include <list.h>
+#include <stddef.h>
 #include "threads/interrupt.h"
-#include "threads/synch.h"
 
 /* An "interrupt queue", a circular buffer shared between
    kernel threads and external interrupt handlers.
@@ -15,29 +16,35 @@
    and condition variables from threads/synch.h cannot be used in
    this case, as they normally would, because they can only
    protect kernel threads from one another, not from interrupt
-   handlers. */
+   handlers.
 
-/* Queue buffer size, in bytes. */
-#define INTQ_BUFSIZE 64
+   Besides the byte-at-a-time intq_getc() and intq_putc(),
+   intq_read() and intq_write() move many bytes with a pair of
+   memcpy() calls, so a driver can move a chunk of data while
+   disabling interrupts only once. */
 
 /* A circular queue of bytes. */
 struct intq
   {
     /* Waiting threads. */
-    struct lock lock;           /* Only one thread may wait at once. */
-    struct thread *not_full;    /* Thread waiting for not-full condition. */
-    struct thread *not_empty;   /* Thread waiting for not-empty condition. */
+    struct list not_full;       /* Threads waiting for not-full condition. */
+    struct list not_empty;      /* Threads waiting for not-empty condition. */
 
     /* Queue. */
-    uint8_t buf[INTQ_BUFSIZE];  /* Buffer. */
-    int head;                   /* New data is written here. */
-    int tail;                   /* Old data is read here. */
+    uint8_t *buf;               /* Buffer, supplied by owner. */
+    size_t size;                /* Bytes in BUF. */
+    size_t head;                /* New data is written here. */
+    size_t tail;                /* Old data is read here. */
   };
 
-void intq_init (struct intq *);
+void intq_init (struct intq *, uint8_t *buf, size_t size);
 bool intq_empty (const struct intq *);
 bool intq_full (const struct intq *);
+size_t intq_cnt (const struct intq *);
+size_t intq_room (const struct intq *);
 uint8_t intq_getc (struct intq *);
 void intq_putc (struct intq *, uint8_t);
+size_t intq_read (struct intq *, void *, size_t max);
+void intq_write (struct intq *, const void *, size_t cnt);
 
 #endif /* devices/intq.h */
@@ -298,27 +298,23 @@ partition_type_name (uint8_t type)
   return type_names[type] != NULL ? type_names[type] : "Unknown";
 }
 
-/* Reads sector SECTOR from partition P into BUFFER, which must
-   have room for BLOCK_SECTOR_SIZE bytes. */
-static void
-partition_read (void *p_, block_sector_t sector, void *buffer)
-{
-  struct partition *p = p_;
-  block_read (p->block, p->start + sector, buffer);
-}
-
-/* Write sector SECTOR to partition P from BUFFER, which must
-   contain BLOCK_SECTOR_SIZE bytes.  Returns after the block has
-   acknowledged receiving the data. */
-static void
-partition_write (void *p_, block_sector_t sector, const void *buffer)
+/* Returns the device that partition P is part of, and converts
+   *SECTOR from a sector within P into a sector within that
+   device. */
+static struct block *
+partition_remap (void *p_, block_sector_t *sector)
 {
   struct partition *p = p_;
-  block_write (p->block, p->start + sector, buffer);
+  *sector += p->start;
+  return p->block;
 }
 
 static struct block_operations partition_operations =
   {
-    partition_read,
-    partition_write
+    NULL,                       /* Read. */
+    NULL,                       /* Write. */
+    NULL,                       /* Vectored read. */
+    NULL,                       /* Vectored write. */
+    partition_remap,
+    NULL                        /* Submit. */
   };
@@ -0,0 +1,182 @@
+#include "devices/pci.h"
+#include <debug.h>
+#include "threads/io.h"
+
+/* The code in this file finds devices on the PCI bus and
+   accesses their configuration space, using configuration
+   mechanism #1 as described in [PCI] section 3.2.2.3.2.  That is
+   all that Pintos needs to drive the few PCI devices it knows
+   about; it does not assign resources, relying on the BIOS to
+   have done so. */
+
+/* Configuration mechanism #1 I/O ports. */
+#define PCI_CONFIG_ADDRESS 0xcf8        /* Address of register to access. */
+#define PCI_CONFIG_DATA 0xcfc           /* Data in register. */
+
+/* Vendor ID read back for absent devices. */
+#define PCI_NO_VENDOR 0xffff
+
+static bool scan (bool (*match) (const struct pci_device *, const void *),
+                  const void *aux, struct pci_device *, bool after);
+
+/* Returns the CONFIG_ADDRESS value that selects register REG of
+   DEV's configuration space. */
+static uint32_t
+config_address (const struct pci_device *dev, uint8_t reg)
+{
+  return (0x80000000 | ((uint32_t) dev->bus << 16) | (dev->slot << 11)
+          | (dev->func << 8) | (reg & 0xfc));
+}
+
+/* Returns the 32-bit configuration register REG of DEV, which
+   must be a multiple of 4. */
+uint32_t
+pci_read_config (const struct pci_device *dev, uint8_t reg)
+{
+  outl (PCI_CONFIG_ADDRESS, config_address (dev, reg));
+  return inl (PCI_CONFIG_DATA);
+}
+
+/* Sets the 32-bit configuration register REG of DEV, which must
+   be a multiple of 4, to VALUE. */
+void
+pci_write_config (const struct pci_device *dev, uint8_t reg, uint32_t value)
+{
+  outl (PCI_CONFIG_ADDRESS, config_address (dev, reg));
+  outl (PCI_CONFIG_DATA, value);
+}
+
+/* Returns the I/O port base address in DEV's base address
+   register BAR, or 0 if BAR does not describe I/O space. */
+uint16_t
+pci_io_base (const struct pci_device *dev, int bar)
+{
+  uint32_t value = pci_read_config (dev, PCI_REG_BAR (bar));
+  return (value & 1) != 0 ? value & 0xfffc : 0;
+}
+
+/* Returns the interrupt vector that DEV's interrupt line is
+   routed to, which is 0x20 plus its IRQ number, or PCI_NO_IRQ if
+   the BIOS routed it nowhere (line 0xff) or DEV has no interrupt
+   pin. */
+uint8_t
+pci_irq (const struct pci_device *dev)
+{
+  uint32_t intr = pci_read_config (dev, PCI_REG_INTR);
+  uint8_t line = intr & 0xff;
+  uint8_t pin = (intr >> 8) & 0xff;
+
+  if (pin == 0 || line >= 16)
+    return PCI_NO_IRQ;
+  return 0x20 + line;
+}
+
+/* Allows DEV to respond to I/O accesses and to master the bus,
+   as it must to do DMA. */
+void
+pci_enable_bus_master (const struct pci_device *dev)
+{
+  uint32_t command = pci_read_config (dev, PCI_REG_COMMAND);
+  pci_write_config (dev, PCI_REG_COMMAND,
+                    (command & 0xffff) | PCI_CMD_IO | PCI_CMD_BUS_MASTER);
+}
+
+/* Matches devices whose class and subclass are those in the
+   two-byte array AUX. */
+static bool
+match_class (const struct pci_device *dev, const void *aux)
+{
+  const uint8_t *class = aux;
+  return dev->class == class[0] && dev->subclass == class[1];
+}
+
+/* Finds the first PCI function with the given CLASS and SUBCLASS
+   and stores it in *DEV.  Returns true if successful, false if
+   there is no such function. */
+bool
+pci_find_class (uint8_t class, uint8_t subclass, struct pci_device *dev)
+{
+  uint8_t aux[2] = { class, subclass };
+  return scan (match_class, aux, dev, false);
+}
+
+/* Matches devices whose vendor and device IDs are those in the
+   two-element array AUX. */
+static bool
+match_id (const struct pci_device *dev, const void *aux)
+{
+  const uint16_t *id = aux;
+  return dev->vendor_id == id[0] && dev->device_id == id[1];
+}
+
+/* Finds the first PCI function with the given VENDOR_ID and
+   DEVICE_ID and stores it in *DEV.  Returns true if successful,
+   false if there is no such function. */
+bool
+pci_find_device (uint16_t vendor_id, uint16_t device_id,
+                 struct pci_device *dev)
+{
+  uint16_t aux[2] = { vendor_id, device_id };
+  return scan (match_id, aux, dev, false);
+}
+
+/* Finds the next PCI function after *DEV, which must have been
+   found by pci_find_device() or this function, with the same
+   vendor and device IDs, and stores it in *DEV.  Returns true if
+   successful, false if there is no such function. */
+bool
+pci_find_next_device (struct pci_device *dev)
+{
+  uint16_t aux[2] = { dev->vendor_id, dev->device_id };
+  return scan (match_id, aux, dev, true);
+}
+
+/* Probes every function on every PCI bus, in order, for one for
+   which MATCH, passed AUX, returns true, and stores it in *DEV.
+   If AFTER is true, starts just past the function already in
+   *DEV instead of at the beginning.  Returns true if successful,
+   false if there is no such function.  If there is no PCI bus at
+   all, every probe reads back all-1s, so nothing matches. */
+static bool
+scan (bool (*match) (const struct pci_device *, const void *),
+      const void *aux, struct pci_device *dev, bool after)
+{
+  int first = after ? (dev->bus << 8 | dev->slot << 3 | dev->func) + 1 : 0;
+  int bus, slot, func;
+
+  for (bus = 0; bus < 256; bus++)
+    for (slot = 0; slot < 32; slot++)
+      for (func = 0; func < 8; func++)
+        {
+          uint32_t id, class;
+
+          if ((bus << 8 | slot << 3 | func) < first)
+            continue;
+
+          dev->bus = bus;
+          dev->slot = slot;
+          dev->func = func;
+          id = pci_read_config (dev, PCI_REG_ID);
+          if ((id & 0xffff) == PCI_NO_VENDOR)
+            {
+              if (func == 0)
+                break;
+              continue;
+            }
+
+          class = pci_read_config (dev, PCI_REG_CLASS);
+          dev->vendor_id = id & 0xffff;
+          dev->device_id = id >> 16;
+          dev->class = class >> 24;
+          dev->subclass = class >> 16;
+          dev->prog_if = class >> 8;
+          if (match (dev, aux))
+            return true;
+
+          /* Only multi-function devices have functions past 0. */
+          if (func == 0
+              && (pci_read_config (dev, PCI_REG_HEADER) & 0x800000) == 0)
+            break;
+        }
+  return false;
+}
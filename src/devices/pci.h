@@ -0,0 +1,48 @@
+#ifndef DEVICES_PCI_H
+#define DEVICES_PCI_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Offsets of some registers in a device's PCI configuration
+   space.  See [PCI] for the rest. */
+#define PCI_REG_ID 0x00                 /* Device ID, vendor ID. */
+#define PCI_REG_COMMAND 0x04            /* Status, command. */
+#define PCI_REG_CLASS 0x08              /* Class, subclass, prog IF, rev. */
+#define PCI_REG_HEADER 0x0c             /* BIST, header type, etc. */
+#define PCI_REG_BAR(N) (0x10 + 4 * (N)) /* Base address register N. */
+#define PCI_REG_INTR 0x3c               /* Interrupt pin and line. */
+
+/* Returned by pci_irq() for a device without a usable interrupt
+   line. */
+#define PCI_NO_IRQ 0
+
+/* Command register bits. */
+#define PCI_CMD_IO 0x0001               /* Respond to I/O space accesses. */
+#define PCI_CMD_BUS_MASTER 0x0004       /* May act as bus master. */
+
+/* A function of a device on the PCI bus. */
+struct pci_device
+  {
+    uint8_t bus;                /* Bus number. */
+    uint8_t slot;               /* Device number on bus. */
+    uint8_t func;               /* Function number within device. */
+    uint16_t vendor_id;         /* Vendor ID. */
+    uint16_t device_id;         /* Device ID. */
+    uint8_t class;              /* Base class, e.g. 0x01 for storage. */
+    uint8_t subclass;           /* Subclass, e.g. 0x01 for IDE. */
+    uint8_t prog_if;            /* Programming interface. */
+  };
+
+bool pci_find_class (uint8_t class, uint8_t subclass, struct pci_device *);
+bool pci_find_device (uint16_t vendor_id, uint16_t device_id,
+                      struct pci_device *);
+bool pci_find_next_device (struct pci_device *);
+
+uint32_t pci_read_config (const struct pci_device *, uint8_t reg);
+void pci_write_config (const struct pci_device *, uint8_t reg, uint32_t);
+uint16_t pci_io_base (const struct pci_device *, int bar);
+uint8_t pci_irq (const struct pci_device *);
+void pci_enable_bus_master (const struct pci_device *);
+
+#endif /* devices/pci.h */
@@ -0,0 +1,95 @@
+#include "devices/ramdisk.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/block.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* A block device whose sectors are kept in kernel memory.  Its
+   contents are lost at power off, but accessing it costs only a
+   memory copy, which makes it useful for measuring the overhead
+   of the software above the block layer, and as fast scratch
+   storage.
+
+   The disk is made of separately allocated pages, rather than
+   one large block, so that it may be as large as free kernel
+   memory allows even if that memory is fragmented. */
+
+/* Sectors per page of RAM disk. */
+#define SECTORS_PER_PAGE (PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* A RAM disk. */
+struct ramdisk
+  {
+    size_t page_cnt;            /* Number of pages. */
+    uint8_t **pages;            /* Pages of sectors. */
+  };
+
+static struct block_operations ramdisk_operations;
+
+/* Creates a RAM disk of KB kilobytes, rounded down to whole
+   pages, and registers it as block device "rd0".  Its contents
+   are initially all zeros.  Like an unpartitioned disk, it plays
+   no Pintos role unless given one with an option such as
+   -filesys=rd0. */
+void
+ramdisk_init (size_t kb)
+{
+  struct ramdisk *rd;
+  size_t i;
+
+  rd = malloc (sizeof *rd);
+  if (rd == NULL)
+    PANIC ("rd0: couldn't allocate RAM disk descriptor");
+  rd->page_cnt = kb * 1024 / PGSIZE;
+  if (rd->page_cnt == 0)
+    PANIC ("rd0: RAM disk must be at least %d kB", PGSIZE / 1024);
+  rd->pages = malloc (rd->page_cnt * sizeof *rd->pages);
+  if (rd->pages == NULL)
+    PANIC ("rd0: couldn't allocate page table for %zu kB RAM disk", kb);
+  for (i = 0; i < rd->page_cnt; i++)
+    {
+      rd->pages[i] = palloc_get_page (PAL_ZERO);
+      if (rd->pages[i] == NULL)
+        PANIC ("rd0: out of kernel memory after %zu kB", i * PGSIZE / 1024);
+    }
+
+  block_register ("rd0", BLOCK_RAW, "RAM disk",
+                  rd->page_cnt * SECTORS_PER_PAGE, &ramdisk_operations, rd);
+}
+
+/* Returns the address of SECTOR within RAM disk RD. */
+static uint8_t *
+sector_addr (const struct ramdisk *rd, block_sector_t sector)
+{
+  return (rd->pages[sector / SECTORS_PER_PAGE]
+          + sector % SECTORS_PER_PAGE * BLOCK_SECTOR_SIZE);
+}
+
+/* Reads sector SECTOR from RAM disk RD into BUFFER, which must
+   have room for BLOCK_SECTOR_SIZE bytes. */
+static void
+ramdisk_read (void *rd, block_sector_t sector, void *buffer)
+{
+  memcpy (buffer, sector_addr (rd, sector), BLOCK_SECTOR_SIZE);
+}
+
+/* Writes sector SECTOR to RAM disk RD from BUFFER, which must
+   contain BLOCK_SECTOR_SIZE bytes. */
+static void
+ramdisk_write (void *rd, block_sector_t sector, const void *buffer)
+{
+  memcpy (sector_addr (rd, sector), buffer, BLOCK_SECTOR_SIZE);
+}
+
+static struct block_operations ramdisk_operations =
+  {
+    ramdisk_read,
+    ramdisk_write,
+    NULL,
+    NULL,
+    NULL,
+    NULL
+  };
@@ -37,6 +37,16 @@
 #define IER_RECV 0x01           /* Interrupt when data received. */
 #define IER_XMIT 0x02           /* Interrupt when transmit finishes. */
 
+/* FIFO Control Register bits. */
+#define FCR_ENABLE 0x01         /* Enable FIFOs. */
+#define FCR_CLEAR_RECV 0x02     /* Clear receive FIFO. */
+#define FCR_CLEAR_XMIT 0x04     /* Clear transmit FIFO. */
+
+/* Size of the 16550A transmit FIFO, in bytes.  When LSR_THRE is
+   set, the whole FIFO is empty, so this many bytes may be written
+   to THR without checking again. */
+#define XMIT_FIFO_SIZE 16
+
 /* Line Control Register bits. */
 #define LCR_N81 0x03            /* No parity, 8 data bits, 1 stop bit. */
 #define LCR_DLAB 0x80           /* Divisor Latch Access Bit (DLAB). */
@@ -51,11 +61,16 @@
 /* Transmission mode. */
 static enum { UNINIT, POLL, QUEUE } mode;
 
-/* Data to be transmitted. */
+/* Data to be transmitted.  A large queue lets a burst of output
+   go out under interrupts without the writer having to wait for
+   the port. */
+#define TXQ_SIZE 4096
 static struct intq txq;
+static uint8_t txq_space[TXQ_SIZE];
 
 static void set_serial (int bps);
 static void putc_poll (uint8_t);
+static void fill_fifo (void);
 static void write_ier (void);
 static intr_handler_func serial_interrupt;
 
@@ -68,10 +83,10 @@ init_poll (void)
 {
   ASSERT (mode == UNINIT);
   outb (IER_REG, 0);                    /* Turn off all interrupts. */
-  outb (FCR_REG, 0);                    /* Disable FIFO. */
-  set_serial (9600);                    /* 9.6 kbps, N-8-1. */
+  outb (FCR_REG, FCR_ENABLE | FCR_CLEAR_RECV | FCR_CLEAR_XMIT);
+  set_serial (115200);                  /* 115.2 kbps, N-8-1. */
   outb (MCR_REG, MCR_OUT2);             /* Required to enable interrupts. */
-  intq_init (&txq);
+  intq_init (&txq, txq_space, sizeof txq_space);
   mode = POLL;
 } 
 
@@ -98,32 +113,63 @@ serial_init_queue (void)
 void
 serial_putc (uint8_t byte) 
 {
+  serial_putbuf (&byte, 1);
+}
+
+/* Sends the N bytes in BUFFER to the serial port.  If called
+   with interrupts off, no other output comes in between.  With
+   interrupts on, this may sleep waiting for room in the transmit
+   queue partway through BUFFER, and other threads' output may
+   come in between then. */
+void
+serial_putbuf (const void *buffer_, size_t n) 
+{
+  const uint8_t *buffer = buffer_;
   enum intr_level old_level = intr_disable ();
 
   if (mode != QUEUE)
     {
       /* If we're not set up for interrupt-driven I/O yet,
-         use dumb polling to transmit a byte. */
+         use dumb polling to transmit the bytes. */
       if (mode == UNINIT)
         init_poll ();
-      putc_poll (byte); 
+      while (n-- > 0)
+        putc_poll (*buffer++); 
     }
   else 
     {
-      /* Otherwise, queue a byte and update the interrupt enable
-         register. */
-      if (old_level == INTR_OFF && intq_full (&txq)) 
+      /* Otherwise, queue as many bytes as fit at a time and
+         update the interrupt enable register, which must enable
+         the transmit interrupt before we might sleep waiting for
+         room. */
+      while (n > 0)
         {
-          /* Interrupts are off and the transmit queue is full.
-             If we wanted to wait for the queue to empty,
-             we'd have to reenable interrupts.
-             That's impolite, so we'll send a character via
-             polling instead. */
-          putc_poll (intq_getc (&txq)); 
+          size_t chunk;
+
+          if (old_level == INTR_OFF && intq_full (&txq)) 
+            {
+              /* Interrupts are off and the transmit queue is
+                 full.  If we wanted to wait for the queue to
+                 empty, we'd have to reenable interrupts.
+                 That's impolite, so we'll send a FIFO's worth of
+                 characters via polling instead. */
+              while ((inb (LSR_REG) & LSR_THRE) == 0)
+                continue;
+              fill_fifo ();
+            }
+
+          /* If the queue is full, queuing one byte waits for
+             the interrupt handler to make room. */
+          chunk = intq_room (&txq);
+          if (chunk == 0)
+            chunk = 1;
+          if (chunk > n)
+            chunk = n;
+          intq_write (&txq, buffer, chunk);
+          write_ier ();
+          buffer += chunk;
+          n -= chunk;
         }
-
-      intq_putc (&txq, byte); 
-      write_ier ();
     }
   
   intr_set_level (old_level);
@@ -136,7 +182,11 @@ serial_flush (void)
 {
   enum intr_level old_level = intr_disable ();
   while (!intq_empty (&txq))
-    putc_poll (intq_getc (&txq));
+    {
+      while ((inb (LSR_REG) & LSR_THRE) == 0)
+        continue;
+      fill_fifo ();
+    }
   intr_set_level (old_level);
 }
 
@@ -205,6 +255,19 @@ putc_poll (uint8_t byte)
   outb (THR_REG, byte);
 }
 
+/* Moves up to a FIFO's worth of bytes from the transmit queue
+   to the port, whose transmit FIFO must be empty. */
+static void
+fill_fifo (void)
+{
+  uint8_t chunk[XMIT_FIFO_SIZE];
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!intq_empty (&txq))
+    outsb (THR_REG, chunk, intq_read (&txq, chunk, sizeof chunk));
+}
+
 /* Serial interrupt handler. */
 static void
 serial_interrupt (struct intr_frame *f UNUSED) 
@@ -218,10 +281,11 @@ serial_interrupt (struct intr_frame *f UNUSED)
   while (!input_full () && (inb (LSR_REG) & LSR_DR) != 0)
     input_putc (inb (RBR_REG));
 
-  /* As long as we have a byte to transmit, and the hardware is
-     ready to accept a byte for transmission, transmit a byte. */
-  while (!intq_empty (&txq) && (inb (LSR_REG) & LSR_THRE) != 0) 
-    outb (THR_REG, intq_getc (&txq));
+  /* If we have bytes to transmit and the transmit FIFO is empty,
+     refill it all at once, instead of polling LSR for each
+     byte. */
+  if (!intq_empty (&txq) && (inb (LSR_REG) & LSR_THRE) != 0) 
+    fill_fifo ();
 
   /* Update interrupt enable register based on queue status. */
   write_ier ();
@@ -97,6 +97,7 @@ shutdown_power_off (void)
   print_stats ();
 
   printf ("Powering off...\n");
+  console_flush ();
   serial_flush ();
 
   /* This is a special power-off sequence supported by Bochs and
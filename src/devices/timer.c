@@ -24,8 +24,25 @@ static int64_t ticks;
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
+/* Nanoseconds in a second and in a timer tick. */
+#define NSEC_PER_SEC 1000000000
+#define NSEC_PER_TICK (NSEC_PER_SEC / TIMER_FREQ)
+
+/* Number of timer ticks over which to measure the time-stamp
+   counter's rate. */
+#define TSC_CALIBRATE_TICKS (TIMER_FREQ / 10)
+
+/* Time-stamp counter rate, in cycles per second, or 0 before
+   timer_calibrate() measures it.  timer_nsec() counts from
+   TSC_BASE, the time-stamp counter value at the timer tick
+   NSEC_BASE nanoseconds after boot. */
+static uint64_t tsc_hz;
+static uint64_t tsc_base;
+static int64_t nsec_base;
+
 static intr_handler_func timer_interrupt;
 static bool too_many_loops (unsigned loops);
+static void calibrate_tsc (void);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
 static void real_time_delay (int64_t num, int32_t denom);
@@ -64,6 +81,35 @@ timer_calibrate (void)
       loops_per_tick |= test_bit;
 
   printf ("%'"PRIu64" loops/s.\n", (uint64_t) loops_per_tick * TIMER_FREQ);
+
+  calibrate_tsc ();
+}
+
+/* Measures the rate of the CPU's time-stamp counter against the
+   timer interrupt, which the 8254 drives at a known frequency,
+   for timer_nsec() to use. */
+static void
+calibrate_tsc (void) 
+{
+  int64_t start;
+  uint64_t start_tsc;
+
+  ASSERT (intr_get_level () == INTR_ON);
+
+  /* Start exactly on a timer tick. */
+  start = timer_ticks ();
+  while (timer_ticks () == start)
+    barrier ();
+  start = timer_ticks ();
+  start_tsc = timer_cycles ();
+
+  while (timer_ticks () < start + TSC_CALIBRATE_TICKS)
+    barrier ();
+
+  tsc_base = start_tsc;
+  nsec_base = start * NSEC_PER_TICK;
+  tsc_hz = (timer_cycles () - start_tsc) * TIMER_FREQ / TSC_CALIBRATE_TICKS;
+  printf ("%'"PRIu64" TSC cycles/s.\n", tsc_hz);
 }
 
 /* Returns the number of timer ticks since the OS booted. */
@@ -84,6 +130,36 @@ timer_elapsed (int64_t then)
   return timer_ticks () - then;
 }
 
+/* Returns the number of CPU clock cycles counted by the CPU's
+   time-stamp counter, for timing intervals much shorter than a
+   timer tick. */
+uint64_t
+timer_cycles (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Returns the number of nanoseconds since the OS booted, as
+   measured by the time-stamp counter once timer_calibrate() has
+   run, and in whole timer ticks until then.  The result never
+   decreases.  May be called from an interrupt handler. */
+int64_t
+timer_nsec (void) 
+{
+  uint64_t cycles;
+
+  if (tsc_hz == 0)
+    return timer_ticks () * NSEC_PER_TICK;
+
+  /* Divide in two steps so that the multiplication by
+     NSEC_PER_SEC cannot overflow. */
+  cycles = timer_cycles () - tsc_base;
+  return (nsec_base + cycles / tsc_hz * NSEC_PER_SEC
+          + cycles % tsc_hz * NSEC_PER_SEC / tsc_hz);
+}
+
 /* Sleeps for approximately TICKS timer ticks.  Interrupts must
    be turned on. */
 void
@@ -0,0 +1,399 @@
+#include "devices/virtio-blk.h"
+#include <debug.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/block.h"
+#include "devices/partition.h"
+#include "devices/pci.h"
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/io.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* The code in this file drives virtio block devices, as
+   emulated by QEMU, through the "legacy" virtio PCI interface
+   described in [VIRTIO] 0.9.5.  Unlike an emulated IDE disk,
+   which traps to the emulator on every port access, a virtio
+   disk takes requests from a ring in memory shared with the
+   emulator, needing one port write per batch of requests, and
+   it may work on many requests at once. */
+
+/* PCI IDs of a legacy virtio block device. */
+#define VIRTIO_VENDOR_ID 0x1af4
+#define VIRTIO_BLK_DEVICE_ID 0x1001
+
+/* Legacy virtio I/O port addresses, relative to BAR 0. */
+#define reg_features(D) ((D)->io_base + 0x00)     /* Device features. */
+#define reg_guest_features(D) ((D)->io_base + 0x04) /* Driver features. */
+#define reg_queue_pfn(D) ((D)->io_base + 0x08)    /* Queue page number. */
+#define reg_queue_size(D) ((D)->io_base + 0x0c)   /* Queue size (r/o). */
+#define reg_queue_select(D) ((D)->io_base + 0x0e) /* Queue select. */
+#define reg_queue_notify(D) ((D)->io_base + 0x10) /* Queue notify. */
+#define reg_status(D) ((D)->io_base + 0x12)       /* Device status. */
+#define reg_isr(D) ((D)->io_base + 0x13)          /* ISR status, clears. */
+#define reg_capacity(D) ((D)->io_base + 0x14)     /* Sectors, 64 bits. */
+
+/* Device Status Register bits. */
+#define STATUS_ACKNOWLEDGE 0x01 /* Guest has noticed device. */
+#define STATUS_DRIVER 0x02      /* Guest can drive device. */
+#define STATUS_DRIVER_OK 0x04   /* Driver is ready. */
+#define STATUS_FAILED 0x80      /* Driver gave up on device. */
+
+/* A virtqueue descriptor, naming one buffer. */
+struct vring_desc
+  {
+    uint64_t addr;              /* Physical address. */
+    uint32_t len;               /* Length in bytes. */
+    uint16_t flags;             /* VRING_DESC_F_* bits. */
+    uint16_t next;              /* Next descriptor, if F_NEXT. */
+  };
+#define VRING_DESC_F_NEXT 1     /* Chained to NEXT. */
+#define VRING_DESC_F_WRITE 2    /* Device writes, rather than reads. */
+
+/* Ring of descriptor chains offered to the device. */
+struct vring_avail
+  {
+    uint16_t flags;
+    uint16_t idx;               /* Where we put the next entry. */
+    uint16_t ring[];            /* Heads of descriptor chains. */
+  };
+
+/* Ring of descriptor chains the device has finished with. */
+struct vring_used_elem
+  {
+    uint32_t id;                /* Head of descriptor chain. */
+    uint32_t len;               /* Bytes written by device. */
+  };
+struct vring_used
+  {
+    uint16_t flags;
+    uint16_t idx;               /* Where device puts next entry. */
+    struct vring_used_elem ring[];
+  };
+
+/* Alignment of the used ring in a legacy virtqueue. */
+#define VRING_ALIGN PGSIZE
+
+/* Header at the start of each virtio block request. */
+struct virtio_blk_hdr
+  {
+    uint32_t type;              /* VIRTIO_BLK_T_*. */
+    uint32_t reserved;
+    uint64_t sector;            /* First sector. */
+  };
+#define VIRTIO_BLK_T_IN 0       /* Read. */
+#define VIRTIO_BLK_T_OUT 1      /* Write. */
+
+/* Status byte at the end of each request, written by device. */
+#define VIRTIO_BLK_S_OK 0
+
+/* Per-request state, indexed by head descriptor. */
+struct slot
+  {
+    struct virtio_blk_hdr hdr;  /* Request header, read by device. */
+    uint8_t status;             /* Status, written by device. */
+    struct block_request *req;  /* Request in flight, or null. */
+  };
+
+/* A virtio block device. */
+struct virtio_disk
+  {
+    char name[8];               /* Name, e.g. "vda". */
+    uint16_t io_base;           /* Base I/O port. */
+    uint8_t irq;                /* Interrupt vector, or PCI_NO_IRQ. */
+
+    uint16_t queue_size;        /* Number of descriptors. */
+    void *queue;                /* Pages holding the virtqueue. */
+    size_t queue_pages;         /* Number of pages at QUEUE. */
+    struct vring_desc *desc;    /* Descriptor table. */
+    struct vring_avail *avail;  /* Available ring. */
+    struct vring_used *used;    /* Used ring. */
+    uint16_t last_used;         /* Next used ring entry to look at. */
+
+    uint16_t free_head;         /* First free descriptor. */
+    uint16_t free_cnt;          /* Number of free descriptors. */
+    struct slot *slots;         /* QUEUE_SIZE slots. */
+    size_t slot_pages;          /* Number of pages at SLOTS. */
+  };
+
+/* We support as many virtio disks as Pintos has disk names. */
+#define DISK_CNT 4
+static struct virtio_disk disks[DISK_CNT];
+static size_t disk_cnt;
+
+static struct block_operations virtio_operations;
+
+static bool init_disk (struct virtio_disk *, const struct pci_device *);
+static void interrupt_handler (struct intr_frame *);
+static thread_func poll_thread NO_RETURN;
+
+/* Finds virtio block devices on the PCI bus and registers each
+   one with the block layer. */
+void
+virtio_blk_init (void)
+{
+  struct pci_device dev;
+  bool found;
+
+  for (found = pci_find_device (VIRTIO_VENDOR_ID, VIRTIO_BLK_DEVICE_ID, &dev);
+       found && disk_cnt < DISK_CNT;
+       found = pci_find_next_device (&dev))
+    {
+      struct virtio_disk *d = &disks[disk_cnt];
+      char extra_info[32];
+      struct block *block;
+      uint64_t capacity;
+      size_t i;
+
+      snprintf (d->name, sizeof d->name, "vd%c", 'a' + (int) disk_cnt);
+      if (!init_disk (d, &dev))
+        {
+          printf ("%s: initialization failed\n", d->name);
+          continue;
+        }
+      disk_cnt++;
+
+      /* Disks may share an interrupt line.  A disk without one is
+         polled instead. */
+      if (d->irq == PCI_NO_IRQ)
+        {
+          printf ("%s: no interrupt line, polling\n", d->name);
+          thread_create (d->name, PRI_DEFAULT, poll_thread, d);
+        }
+      else
+        {
+          for (i = 0; i + 1 < disk_cnt; i++)
+            if (disks[i].irq == d->irq)
+              break;
+          if (i + 1 == disk_cnt)
+            intr_register_ext (d->irq, interrupt_handler, "virtio-blk");
+        }
+
+      capacity = inl (reg_capacity (d))
+                 | (uint64_t) inl (reg_capacity (d) + 4) << 32;
+      if (capacity > UINT32_MAX)
+        capacity = UINT32_MAX;
+      snprintf (extra_info, sizeof extra_info, "virtio, %"PRIu16" slots",
+                d->queue_size);
+      block = block_register (d->name, BLOCK_RAW, extra_info, capacity,
+                              &virtio_operations, d);
+      partition_scan (block);
+    }
+}
+
+/* Resets the device DEV and sets up its request queue, as the
+   device D.  Returns true if successful, false on failure. */
+static bool
+init_disk (struct virtio_disk *d, const struct pci_device *dev)
+{
+  size_t desc_size, avail_size, used_size, i;
+
+  d->io_base = pci_io_base (dev, 0);
+  d->irq = pci_irq (dev);
+  if (d->io_base == 0)
+    return false;
+  pci_enable_bus_master (dev);
+
+  /* Reset, then introduce ourselves.  We need none of the
+     optional features. */
+  outb (reg_status (d), 0);
+  outb (reg_status (d), STATUS_ACKNOWLEDGE);
+  outb (reg_status (d), STATUS_ACKNOWLEDGE | STATUS_DRIVER);
+  outl (reg_guest_features (d), 0);
+
+  /* Lay out queue 0 in physically contiguous pages, as the
+     legacy interface requires: descriptors, then available
+     ring, then, on the next page, used ring. */
+  outw (reg_queue_select (d), 0);
+  d->queue_size = inw (reg_queue_size (d));
+  if (d->queue_size == 0)
+    goto fail;
+  desc_size = sizeof *d->desc * d->queue_size;
+  avail_size = sizeof *d->avail + sizeof d->avail->ring[0] * (d->queue_size + 1);
+  used_size = sizeof *d->used + sizeof d->used->ring[0] * d->queue_size
+              + sizeof (uint16_t);
+  d->queue_pages = (DIV_ROUND_UP (desc_size + avail_size, VRING_ALIGN)
+                    + DIV_ROUND_UP (used_size, VRING_ALIGN));
+  d->queue = palloc_get_multiple (PAL_ZERO, d->queue_pages);
+  d->slot_pages = DIV_ROUND_UP (sizeof *d->slots * d->queue_size, PGSIZE);
+  d->slots = palloc_get_multiple (PAL_ZERO, d->slot_pages);
+  if (d->queue == NULL || d->slots == NULL)
+    {
+      palloc_free_multiple (d->queue, d->queue_pages);
+      palloc_free_multiple (d->slots, d->slot_pages);
+      goto fail;
+    }
+  d->desc = d->queue;
+  d->avail = (struct vring_avail *) ((uint8_t *) d->queue + desc_size);
+  d->used = (struct vring_used *) ((uint8_t *) d->queue
+                                   + ROUND_UP (desc_size + avail_size,
+                                               VRING_ALIGN));
+  d->last_used = 0;
+
+  /* Chain all the descriptors into a free list. */
+  for (i = 0; i + 1 < d->queue_size; i++)
+    d->desc[i].next = i + 1;
+  d->free_head = 0;
+  d->free_cnt = d->queue_size;
+
+  outl (reg_queue_pfn (d), vtop (d->queue) / VRING_ALIGN);
+  outb (reg_status (d),
+        STATUS_ACKNOWLEDGE | STATUS_DRIVER | STATUS_DRIVER_OK);
+  return true;
+
+ fail:
+  outb (reg_status (d), STATUS_FAILED);
+  return false;
+}
+
+/* Fills in descriptor IDX of D to describe the SIZE bytes of
+   kernel memory at BUFFER, with the given FLAGS. */
+static void
+set_desc (struct virtio_disk *d, uint16_t idx, const void *buffer,
+          size_t size, uint16_t flags)
+{
+  /* Kernel virtual memory maps physical memory contiguously, so
+     BUFFER is physically contiguous too. */
+  ASSERT (is_kernel_vaddr (buffer));
+  d->desc[idx].addr = vtop (buffer);
+  d->desc[idx].len = size;
+  d->desc[idx].flags = flags;
+}
+
+/* Starts carrying out REQ on disk D_, if D_ has enough free
+   descriptors for it, and returns true.  Otherwise, returns
+   false.  Each request takes one descriptor for its header, one
+   per buffer, and one for its status byte. */
+static bool
+virtio_submit (void *d_, struct block_request *req)
+{
+  struct virtio_disk *d = d_;
+  size_t need = req->iov_cnt + 2;
+  enum intr_level old_level;
+  struct slot *slot;
+  uint16_t head, idx;
+  size_t i;
+
+  ASSERT (need <= d->queue_size);
+
+  /* The interrupt handler frees descriptors, so keep it out. */
+  old_level = intr_disable ();
+  if (d->free_cnt < need)
+    {
+      intr_set_level (old_level);
+      return false;
+    }
+
+  head = idx = d->free_head;
+  slot = &d->slots[head];
+  slot->hdr.type = req->write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;
+  slot->hdr.reserved = 0;
+  slot->hdr.sector = req->sector;
+  slot->status = 0xff;
+  slot->req = req;
+
+  set_desc (d, idx, &slot->hdr, sizeof slot->hdr, VRING_DESC_F_NEXT);
+  for (i = 0; i < req->iov_cnt; i++)
+    {
+      idx = d->desc[idx].next;
+      set_desc (d, idx, req->iov[i].buffer,
+                req->iov[i].sector_cnt * BLOCK_SECTOR_SIZE,
+                VRING_DESC_F_NEXT | (req->write ? 0 : VRING_DESC_F_WRITE));
+    }
+  idx = d->desc[idx].next;
+  set_desc (d, idx, &slot->status, sizeof slot->status, VRING_DESC_F_WRITE);
+  d->free_head = d->desc[idx].next;
+  d->free_cnt -= need;
+
+  /* Offer the chain to the device.  The device must see the
+     descriptors before the ring entry, and the ring entry before
+     the new index. */
+  d->avail->ring[d->avail->idx % d->queue_size] = head;
+  barrier ();
+  d->avail->idx++;
+  barrier ();
+  outw (reg_queue_notify (d), 0);
+
+  intr_set_level (old_level);
+  return true;
+}
+
+static struct block_operations virtio_operations =
+  {
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    virtio_submit
+  };
+
+/* Completes each request that disk D has finished with, and
+   returns its descriptors to the free list. */
+static void
+reap_requests (struct virtio_disk *d)
+{
+  while (d->last_used != d->used->idx)
+    {
+      struct vring_used_elem *e = &d->used->ring[d->last_used % d->queue_size];
+      struct slot *slot = &d->slots[e->id];
+      struct block_request *req = slot->req;
+      uint16_t idx = e->id;
+      uint16_t cnt = 1;
+
+      barrier ();
+      if (slot->status != VIRTIO_BLK_S_OK)
+        PANIC ("%s: disk %s failed, sector=%"PRDSNu", status=%d",
+               d->name, req->write ? "write" : "read", req->sector,
+               slot->status);
+
+      /* Put the chain back on the free list. */
+      while (d->desc[idx].flags & VRING_DESC_F_NEXT)
+        {
+          idx = d->desc[idx].next;
+          cnt++;
+        }
+      d->desc[idx].next = d->free_head;
+      d->free_head = e->id;
+      d->free_cnt += cnt;
+      slot->req = NULL;
+      d->last_used++;
+
+      block_complete (req);
+    }
+}
+
+/* Completes the requests of disk D_, which has no interrupt
+   line, every timer tick.  Interrupts are turned off while doing
+   so, as they would be in interrupt_handler(). */
+static void
+poll_thread (void *d_) 
+{
+  struct virtio_disk *d = d_;
+
+  for (;;)
+    {
+      enum intr_level old_level = intr_disable ();
+      reap_requests (d);
+      intr_set_level (old_level);
+      timer_sleep (1);
+    }
+}
+
+/* Virtio interrupt handler. */
+static void
+interrupt_handler (struct intr_frame *f)
+{
+  size_t i;
+
+  for (i = 0; i < disk_cnt; i++)
+    {
+      struct virtio_disk *d = &disks[i];
+      if (d->irq == f->vec_no && (inb (reg_isr (d)) & 1) != 0)
+        reap_requests (d);
+    }
+}
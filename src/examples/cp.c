@@ -9,6 +9,7 @@ int
 main (int argc, char *argv[]) 
 {
   int in_fd, out_fd;
+  int size, total = 0;
 
   if (argc != 3) 
     {
@@ -25,7 +26,8 @@ main (int argc, char *argv[])
     }
 
   /* Create and open output file. */
-  if (!create (argv[2], filesize (in_fd))) 
+  size = filesize (in_fd);
+  if (!create (argv[2], size)) 
     {
       printf ("%s: create failed\n", argv[2]);
       return EXIT_FAILURE;
@@ -37,18 +39,18 @@ main (int argc, char *argv[])
       return EXIT_FAILURE;
     }
 
-  /* Copy data. */
-  for (;;) 
+  /* Copy data, inside the kernel.  A copy that ends early, with
+     nothing copied, means the output file could not take it. */
+  while (total < size) 
     {
-      char buffer[1024];
-      int bytes_read = read (in_fd, buffer, sizeof buffer);
-      if (bytes_read == 0)
-        break;
-      if (write (out_fd, buffer, bytes_read) != bytes_read) 
+      int bytes_copied = copy_file_range (in_fd, out_fd, 65536);
+      if (bytes_copied <= 0) 
         {
-          printf ("%s: write failed\n", argv[2]);
+          printf ("%s: write failed after %d of %d bytes\n",
+                  argv[2], total, size);
           return EXIT_FAILURE;
         }
+      total += bytes_copied;
     }
 
   return EXIT_SUCCESS;
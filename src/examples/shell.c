@@ -5,6 +5,7 @@
 
 static void read_line (char line[], size_t);
 static bool backspace (char **pos, char line[]);
+static void run_pipeline (char *left, char *right);
 
 int
 main (void)
@@ -30,6 +31,12 @@ main (void)
         {
           /* Empty command. */
         }
+      else if (strchr (command, '|') != NULL)
+        {
+          char *bar = strchr (command, '|');
+          *bar = '\0';
+          run_pipeline (command, bar + 1);
+        }
       else
         {
           pid_t pid = exec (command);
@@ -44,6 +51,54 @@ main (void)
   return EXIT_SUCCESS;
 }
 
+/* Runs commands LEFT and RIGHT at the same time, with LEFT's
+   output going to RIGHT's input through a pipe.  A process that
+   we run inherits our file descriptors, so we point our own
+   standard output at the pipe while we start LEFT, and our own
+   standard input at it while we start RIGHT.  Both of the pipe's
+   own descriptors are close-on-exec, so LEFT holds no read end:
+   if RIGHT quits early, LEFT's writes fail instead of waiting
+   forever for room. */
+static void
+run_pipeline (char *left, char *right) 
+{
+  int fds[2], saved;
+  pid_t left_pid, right_pid;
+
+  while (*right == ' ')
+    right++;
+  if (pipe (fds) < 0) 
+    {
+      printf ("pipe failed\n");
+      return;
+    }
+  set_cloexec (fds[0], true);
+  set_cloexec (fds[1], true);
+
+  saved = dup (STDOUT_FILENO);
+  dup2 (fds[1], STDOUT_FILENO);
+  left_pid = exec (left);
+  dup2 (saved, STDOUT_FILENO);
+  close (saved);
+  close (fds[1]);
+
+  saved = dup (STDIN_FILENO);
+  dup2 (fds[0], STDIN_FILENO);
+  right_pid = exec (right);
+  dup2 (saved, STDIN_FILENO);
+  close (saved);
+  close (fds[0]);
+
+  if (left_pid != PID_ERROR)
+    printf ("\"%s\": exit code %d\n", left, wait (left_pid));
+  else
+    printf ("exec failed\n");
+  if (right_pid != PID_ERROR)
+    printf ("\"%s\": exit code %d\n", right, wait (right_pid));
+  else
+    printf ("exec failed\n");
+}
+
 /* Reads a line of input from the user into LINE, which has room
    for SIZE bytes.  Handles backspace and Ctrl+U in the ways
    expected by Unix users.  On return, LINE will always be
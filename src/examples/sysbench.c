@@ -0,0 +1,60 @@
+/* sysbench.c
+
+   Measures the mean time taken by a system call that does almost
+   no work, monotime(), made with int $0x30 and, if the CPU
+   supports it, with sysenter.
+
+   Usage: sysbench [ITERATIONS] */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+
+/* Default number of system calls to time with each method. */
+#define DEFAULT_ITERATIONS 100000
+
+/* Returns the mean time, in nanoseconds, of CNT calls to
+   monotime(), less that of the loop around them.  I is volatile
+   so that the compiler keeps the empty loop, and keeps it as
+   costly as the other. */
+static int64_t
+time_syscalls (int cnt)
+{
+  int64_t start, calls, loop;
+  volatile int i;
+
+  start = monotime ();
+  for (i = 0; i < cnt; i++)
+    monotime ();
+  calls = monotime () - start;
+
+  start = monotime ();
+  for (i = 0; i < cnt; i++)
+    continue;
+  loop = monotime () - start;
+
+  return (calls - loop) / cnt;
+}
+
+int
+main (int argc, char *argv[])
+{
+  int cnt = argc > 1 ? atoi (argv[1]) : DEFAULT_ITERATIONS;
+
+  if (cnt <= 0)
+    {
+      printf ("usage: sysbench [ITERATIONS]\n");
+      return EXIT_FAILURE;
+    }
+
+  syscall_set_sysenter (false);
+  printf ("int $0x30: %"PRId64" ns per call\n", time_syscalls (cnt));
+
+  if (syscall_set_sysenter (true))
+    printf ("sysenter:  %"PRId64" ns per call\n", time_syscalls (cnt));
+  else
+    printf ("sysenter:  not supported\n");
+
+  return EXIT_SUCCESS;
+}
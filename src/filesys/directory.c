@@ -234,3 +234,47 @@ dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
     }
   return false;
 }
+
+/* Checks the entries in DIR for consistency, and checks the inode
+   of each file in DIR with inode_check(), marking the sectors
+   that they occupy in USED.  Prints a message for each problem
+   found.  Returns true if no problem was found, false otherwise. */
+bool
+dir_check (struct dir *dir, struct bitmap *used)
+{
+  struct dir_entry e, prev;
+  off_t ofs, prev_ofs;
+  bool ok = true;
+
+  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+       ofs += sizeof e)
+    {
+      if (!e.in_use)
+        continue;
+
+      if (e.name[0] == '\0' || memchr (e.name, '\0', sizeof e.name) == NULL)
+        {
+          printf ("directory entry at offset %"PROTd": bad name\n", ofs);
+          ok = false;
+          continue;
+        }
+
+      for (prev_ofs = 0; prev_ofs < ofs; prev_ofs += sizeof prev)
+        if (inode_read_at (dir->inode, &prev, sizeof prev, prev_ofs)
+            == sizeof prev
+            && prev.in_use && !strcmp (prev.name, e.name))
+          {
+            printf ("%s: duplicate directory entry\n", e.name);
+            ok = false;
+            break;
+          }
+
+      if (!inode_check (e.inode_sector, used))
+        {
+          printf ("%s: bad inode in sector %"PRDSNu"\n",
+                  e.name, e.inode_sector);
+          ok = false;
+        }
+    }
+  return ok;
+}
@@ -12,6 +12,7 @@
 #define NAME_MAX 14
 
 struct inode;
+struct bitmap;
 
 /* Opening and closing directories. */
 bool dir_create (block_sector_t sector, size_t entry_cnt);
@@ -27,4 +28,7 @@ bool dir_add (struct dir *, const char *name, block_sector_t);
 bool dir_remove (struct dir *, const char *name);
 bool dir_readdir (struct dir *, char name[NAME_MAX + 1]);
 
+/* Maintenance. */
+bool dir_check (struct dir *, struct bitmap *used);
+
 #endif /* filesys/directory.h */
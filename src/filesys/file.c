@@ -9,6 +9,7 @@ struct file
     struct inode *inode;        /* File's inode. */
     off_t pos;                  /* Current position. */
     bool deny_write;            /* Has file_deny_write() been called? */
+    int open_cnt;               /* Number of openers; see file_dup(). */
   };
 
 /* Opens a file for the given INODE, of which it takes ownership,
@@ -23,6 +24,7 @@ file_open (struct inode *inode)
       file->inode = inode;
       file->pos = 0;
       file->deny_write = false;
+      file->open_cnt = 1;
       return file;
     }
   else
@@ -41,11 +43,21 @@ file_reopen (struct file *file)
   return file_open (inode_reopen (file->inode));
 }
 
-/* Closes FILE. */
+/* Returns FILE after adding an opener to it.  Unlike
+   file_reopen(), the result shares FILE's position.  Each opener
+   must call file_close() once. */
+struct file *
+file_dup (struct file *file) 
+{
+  file->open_cnt++;
+  return file;
+}
+
+/* Closes FILE.  It is freed once its last opener closes it. */
 void
 file_close (struct file *file) 
 {
-  if (file != NULL)
+  if (file != NULL && --file->open_cnt == 0)
     {
       file_allow_write (file);
       inode_close (file->inode);
@@ -84,6 +96,19 @@ file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs)
   return inode_read_at (file->inode, buffer, size, file_ofs);
 }
 
+/* Reads SIZE bytes from FILE into PAGES, starting at offset
+   FILE_OFS in the file, which must be sector-aligned.  PAGES must
+   have room for SIZE rounded up to a whole disk sector; see
+   inode_read_pages().
+   Returns the number of bytes actually read,
+   which may be less than SIZE if end of file is reached.
+   The file's current position is unaffected. */
+off_t
+file_read_pages (struct file *file, void *pages, off_t size, off_t file_ofs) 
+{
+  return inode_read_pages (file->inode, pages, size, file_ofs);
+}
+
 /* Writes SIZE bytes from BUFFER into FILE,
    starting at the file's current position.
    Returns the number of bytes actually written,
@@ -113,6 +138,24 @@ file_write_at (struct file *file, const void *buffer, off_t size,
   return inode_write_at (file->inode, buffer, size, file_ofs);
 }
 
+/* Copies SIZE bytes from SRC, starting at its current position,
+   to DST, starting at its current position, without the data
+   leaving the kernel.  Returns the number of bytes actually
+   copied, which may be less than SIZE if end of either file is
+   reached, or -1 if memory is short.  Advances both positions by
+   the number of bytes copied. */
+off_t
+file_copy (struct file *dst, struct file *src, off_t size) 
+{
+  off_t bytes_copied = inode_copy (dst->inode, dst->pos,
+                                   src->inode, src->pos, size);
+  if (bytes_copied < 0)
+    return -1;
+  dst->pos += bytes_copied;
+  src->pos += bytes_copied;
+  return bytes_copied;
+}
+
 /* Prevents write operations on FILE's underlying inode
    until file_allow_write() is called or FILE is closed. */
 void
@@ -6,6 +6,7 @@
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
 #include "filesys/directory.h"
+#include "filesys/journal.h"
 
 /* Partition that contains the file system. */
 struct block *fs_device;
@@ -22,10 +23,13 @@ filesys_init (bool format)
     PANIC ("No file system device found, can't initialize file system.");
 
   inode_init ();
+  journal_init ();
   free_map_init ();
 
   if (format) 
     do_format ();
+  else
+    journal_recover ();
 
   free_map_open ();
 }
@@ -36,6 +40,7 @@ void
 filesys_done (void) 
 {
   free_map_close ();
+  journal_done ();
 }
 
 /* Creates a file named NAME with the given INITIAL_SIZE.
@@ -46,14 +51,19 @@ bool
 filesys_create (const char *name, off_t initial_size) 
 {
   block_sector_t inode_sector = 0;
-  struct dir *dir = dir_open_root ();
-  bool success = (dir != NULL
-                  && free_map_allocate (1, &inode_sector)
-                  && inode_create (inode_sector, initial_size)
-                  && dir_add (dir, name, inode_sector));
+  struct dir *dir;
+  bool success;
+
+  journal_begin ();
+  dir = dir_open_root ();
+  success = (dir != NULL
+             && free_map_allocate (1, &inode_sector)
+             && inode_create (inode_sector, initial_size)
+             && dir_add (dir, name, inode_sector));
   if (!success && inode_sector != 0) 
     free_map_release (inode_sector, 1);
   dir_close (dir);
+  journal_end ();
 
   return success;
 }
@@ -83,9 +93,14 @@ filesys_open (const char *name)
 bool
 filesys_remove (const char *name) 
 {
-  struct dir *dir = dir_open_root ();
-  bool success = dir != NULL && dir_remove (dir, name);
+  struct dir *dir;
+  bool success;
+
+  journal_begin ();
+  dir = dir_open_root ();
+  success = dir != NULL && dir_remove (dir, name);
   dir_close (dir); 
+  journal_end ();
 
   return success;
 }
@@ -95,6 +110,7 @@ static void
 do_format (void)
 {
   printf ("Formatting file system...");
+  journal_create ();
   free_map_create ();
   if (!dir_create (ROOT_DIR_SECTOR, 16))
     PANIC ("root directory creation failed");
@@ -4,6 +4,7 @@
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per sector. */
@@ -17,6 +18,8 @@ free_map_init (void)
     PANIC ("bitmap creation failed--file system device is too large");
   bitmap_mark (free_map, FREE_MAP_SECTOR);
   bitmap_mark (free_map, ROOT_DIR_SECTOR);
+  if (journal_fits ())
+    bitmap_set_multiple (free_map, JOURNAL_SECTOR, JOURNAL_SECTORS, true);
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
@@ -49,6 +52,64 @@ free_map_release (block_sector_t sector, size_t cnt)
   bitmap_write (free_map, free_map_file);
 }
 
+/* Compares the free map against USED, which has one bit per
+   sector that is actually in use.  Stores the number of sectors
+   that are allocated but not in use in *LEAKED_CNT and the
+   number that are in use but not allocated in *UNMARKED_CNT. */
+void
+free_map_compare (const struct bitmap *used,
+                  size_t *leaked_cnt, size_t *unmarked_cnt)
+{
+  size_t i;
+
+  ASSERT (bitmap_size (used) == bitmap_size (free_map));
+
+  *leaked_cnt = *unmarked_cnt = 0;
+  for (i = 0; i < bitmap_size (free_map); i++)
+    if (bitmap_test (free_map, i) != bitmap_test (used, i))
+      {
+        if (bitmap_test (free_map, i))
+          ++*leaked_cnt;
+        else
+          ++*unmarked_cnt;
+      }
+}
+
+/* Replaces the free map by USED, which has one bit per sector
+   that is actually in use, and writes it to disk. */
+void
+free_map_repair (const struct bitmap *used)
+{
+  size_t i;
+
+  ASSERT (bitmap_size (used) == bitmap_size (free_map));
+
+  for (i = 0; i < bitmap_size (free_map); i++)
+    bitmap_set (free_map, i, bitmap_test (used, i));
+  bitmap_write (free_map, free_map_file);
+}
+
+/* Returns the number of free sectors in the free map and stores
+   the length of the longest run of them in *LONGEST_RUN. */
+size_t
+free_map_free_cnt (size_t *longest_run)
+{
+  size_t free_cnt = 0, run = 0;
+  size_t i;
+
+  *longest_run = 0;
+  for (i = 0; i < bitmap_size (free_map); i++)
+    if (!bitmap_test (free_map, i))
+      {
+        free_cnt++;
+        if (++run > *longest_run)
+          *longest_run = run;
+      }
+    else
+      run = 0;
+  return free_cnt;
+}
+
 /* Opens the free map file and reads it from disk. */
 void
 free_map_open (void) 
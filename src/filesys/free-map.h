@@ -5,6 +5,8 @@
 #include <stddef.h>
 #include "devices/block.h"
 
+struct bitmap;
+
 void free_map_init (void);
 void free_map_read (void);
 void free_map_create (void);
@@ -14,4 +16,9 @@ void free_map_close (void);
 bool free_map_allocate (size_t, block_sector_t *);
 void free_map_release (block_sector_t, size_t);
 
+void free_map_compare (const struct bitmap *used,
+                       size_t *leaked_cnt, size_t *unmarked_cnt);
+void free_map_repair (const struct bitmap *used);
+size_t free_map_free_cnt (size_t *longest_run);
+
 #endif /* filesys/free-map.h */
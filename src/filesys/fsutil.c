@@ -1,5 +1,7 @@
 #include "filesys/fsutil.h"
+#include <bitmap.h>
 #include <debug.h>
+#include <round.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -7,6 +9,9 @@
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "filesys/free-map.h"
+#include "filesys/inode.h"
+#include "filesys/journal.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/vaddr.h"
@@ -67,27 +72,199 @@ fsutil_rm (char **argv)
     PANIC ("%s: delete failed\n", file_name);
 }
 
+/* Checks the consistency of the file system: every inode, every
+   root directory entry, and the free map.  If the inodes and
+   directory are sound but the free map disagrees with them, the
+   free map is rebuilt from the sectors actually in use. */
+void
+fsutil_fsck (char **argv UNUSED)
+{
+  struct bitmap *used;
+  struct dir *dir;
+  size_t leaked_cnt, unmarked_cnt;
+  bool ok = true;
+
+  printf ("Checking file system...\n");
+  used = bitmap_create (block_size (fs_device));
+  if (used == NULL)
+    PANIC ("couldn't allocate bitmap");
+  if (journal_enabled ())
+    bitmap_set_multiple (used, JOURNAL_SECTOR, JOURNAL_SECTORS, true);
+
+  /* Mark every sector in use, checking the owner of each. */
+  if (!inode_check (FREE_MAP_SECTOR, used))
+    {
+      printf ("free map: bad inode\n");
+      ok = false;
+    }
+  if (!inode_check (ROOT_DIR_SECTOR, used))
+    {
+      printf ("root directory: bad inode\n");
+      ok = false;
+    }
+  else
+    {
+      dir = dir_open_root ();
+      if (dir == NULL)
+        PANIC ("root dir open failed");
+      if (!dir_check (dir, used))
+        ok = false;
+      dir_close (dir);
+    }
+
+  /* Compare against the free map. */
+  free_map_compare (used, &leaked_cnt, &unmarked_cnt);
+  if (leaked_cnt > 0 || unmarked_cnt > 0)
+    {
+      printf ("free map: %zu sectors allocated but unused, "
+              "%zu in use but free\n", leaked_cnt, unmarked_cnt);
+      if (ok)
+        {
+          printf ("Rebuilding free map...\n");
+          free_map_repair (used);
+        }
+      else
+        printf ("Not rebuilding free map: inodes or directory damaged.\n");
+    }
+
+  bitmap_destroy (used);
+  printf ("File system check %s.\n",
+          ok ? "done" : "found damaged inodes or directory entries");
+}
+
+/* Compacts file data toward the start of the file system device,
+   so that free space coalesces into long runs.  Each file's data
+   is moved, in one piece, to the lowest free run that holds it,
+   and passes over the root directory repeat until no more data
+   moves.  Files that are open elsewhere are skipped. */
+void
+fsutil_defrag (char **argv UNUSED)
+{
+  size_t free_cnt, longest_run, moved_cnt, pass_moved;
+  struct inode *inode;
+  struct dir *dir;
+  char name[NAME_MAX + 1];
+
+  free_cnt = free_map_free_cnt (&longest_run);
+  printf ("Defragmenting file system: %zu free sectors, "
+          "longest free run %zu...\n", free_cnt, longest_run);
+
+  moved_cnt = 0;
+  do
+    {
+      pass_moved = 0;
+
+      dir = dir_open_root ();
+      if (dir == NULL)
+        PANIC ("root dir open failed");
+      while (dir_readdir (dir, name))
+        if (dir_lookup (dir, name, &inode))
+          {
+            if (inode_relocate (inode))
+              pass_moved++;
+            inode_close (inode);
+          }
+      dir_close (dir);
+
+      /* The root directory's own data can move too, once no one
+         else has it open. */
+      inode = inode_open (ROOT_DIR_SECTOR);
+      if (inode != NULL && inode_relocate (inode))
+        pass_moved++;
+      inode_close (inode);
+
+      moved_cnt += pass_moved;
+    }
+  while (pass_moved > 0);
+
+  free_cnt = free_map_free_cnt (&longest_run);
+  printf ("Moved %zu files; longest free run now %zu sectors.\n",
+          moved_cnt, longest_run);
+}
+
+/* Number of pages, and so of sectors, that fsutil_extract()
+   reads from the scratch device at a time. */
+#define EXTRACT_PAGES 8
+#define EXTRACT_SECTORS (EXTRACT_PAGES * PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* Reads a block device sequentially, many sectors at a time. */
+struct sector_stream
+  {
+    struct block *block;        /* Device to read. */
+    block_sector_t next;        /* Next sector to read from device. */
+    uint8_t *buffer;            /* EXTRACT_SECTORS sectors of buffer. */
+    size_t cnt;                 /* Sectors in buffer. */
+    size_t ofs;                 /* Sectors already consumed in buffer. */
+  };
+
+/* Returns the position of the next unconsumed sector in STREAM
+   and stores up to MAX_CNT consecutive sectors, starting there,
+   into *DATA.  Returns the number stored, which is at least 1. */
+static size_t
+stream_get (struct sector_stream *stream, size_t max_cnt, void **data)
+{
+  size_t cnt;
+
+  if (stream->ofs >= stream->cnt)
+    {
+      /* Refill the buffer from the device. */
+      block_sector_t dev_size = block_size (stream->block);
+
+      if (stream->next >= dev_size)
+        PANIC ("unexpected end of archive at sector %"PRDSNu, stream->next);
+      stream->cnt = dev_size - stream->next;
+      if (stream->cnt > EXTRACT_SECTORS)
+        stream->cnt = EXTRACT_SECTORS;
+      block_read_multi (stream->block, stream->next, stream->cnt,
+                        stream->buffer);
+      stream->next += stream->cnt;
+      stream->ofs = 0;
+    }
+
+  cnt = stream->cnt - stream->ofs;
+  if (cnt > max_cnt)
+    cnt = max_cnt;
+  *data = stream->buffer + stream->ofs * BLOCK_SECTOR_SIZE;
+  stream->ofs += cnt;
+  return cnt;
+}
+
+/* Returns the device sector number of the next sector that
+   STREAM would return. */
+static block_sector_t
+stream_tell (const struct sector_stream *stream)
+{
+  return stream->next - (stream->cnt - stream->ofs);
+}
+
 /* Extracts a ustar-format tar archive from the scratch block
-   device into the Pintos file system. */
+   device into the Pintos file system.
+
+   The archive is read EXTRACT_SECTORS at a time, and each file's
+   data is written with as few, and as large, writes as that
+   allows.  filesys_create() allocates each file's data as one
+   contiguous run from the size in its header, so the writes are
+   sequential on disk too. */
 void
 fsutil_extract (char **argv UNUSED) 
 {
   static block_sector_t sector = 0;
 
-  struct block *src;
-  void *header, *data;
-
-  /* Allocate buffers. */
-  header = malloc (BLOCK_SECTOR_SIZE);
-  data = malloc (BLOCK_SECTOR_SIZE);
-  if (header == NULL || data == NULL)
-    PANIC ("couldn't allocate buffers");
+  struct sector_stream stream;
+  void *header;
 
   /* Open source block device. */
-  src = block_get_role (BLOCK_SCRATCH);
-  if (src == NULL)
+  stream.block = block_get_role (BLOCK_SCRATCH);
+  if (stream.block == NULL)
     PANIC ("couldn't open scratch device");
 
+  /* Allocate buffer. */
+  stream.buffer = palloc_get_multiple (0, EXTRACT_PAGES);
+  if (stream.buffer == NULL)
+    PANIC ("couldn't allocate buffer");
+  stream.next = sector;
+  stream.cnt = stream.ofs = 0;
+
   printf ("Extracting ustar archive from scratch device "
           "into file system...\n");
 
@@ -99,10 +276,11 @@ fsutil_extract (char **argv UNUSED)
       int size;
 
       /* Read and parse ustar header. */
-      block_read (src, sector++, header);
+      stream_get (&stream, 1, &header);
       error = ustar_parse_header (header, &file_name, &type, &size);
       if (error != NULL)
-        PANIC ("bad ustar header in sector %"PRDSNu" (%s)", sector - 1, error);
+        PANIC ("bad ustar header in sector %"PRDSNu" (%s)",
+               stream_tell (&stream) - 1, error);
 
       if (type == USTAR_EOF)
         {
@@ -117,20 +295,26 @@ fsutil_extract (char **argv UNUSED)
 
           printf ("Putting '%s' into the file system...\n", file_name);
 
-          /* Create destination file. */
+          /* Create destination file.  This allocates all of its
+             data sectors at once. */
           if (!filesys_create (file_name, size))
             PANIC ("%s: create failed", file_name);
           dst = filesys_open (file_name);
           if (dst == NULL)
             PANIC ("%s: open failed", file_name);
 
-          /* Do copy. */
+          /* Do copy, as many buffered sectors at a time as
+             possible. */
           while (size > 0)
             {
-              int chunk_size = (size > BLOCK_SECTOR_SIZE
-                                ? BLOCK_SECTOR_SIZE
-                                : size);
-              block_read (src, sector++, data);
+              void *data;
+              size_t sector_cnt = stream_get (&stream,
+                                              DIV_ROUND_UP (size,
+                                                            BLOCK_SECTOR_SIZE),
+                                              &data);
+              int chunk_size = sector_cnt * BLOCK_SECTOR_SIZE;
+              if (chunk_size > size)
+                chunk_size = size;
               if (file_write (dst, data, chunk_size) != chunk_size)
                 PANIC ("%s: write failed with %d bytes unwritten",
                        file_name, size);
@@ -141,18 +325,18 @@ fsutil_extract (char **argv UNUSED)
           file_close (dst);
         }
     }
+  sector = stream_tell (&stream);
 
   /* Erase the ustar header from the start of the block device,
      so that the extraction operation is idempotent.  We erase
      two blocks because two blocks of zeros are the ustar
      end-of-archive marker. */
   printf ("Erasing ustar archive...\n");
-  memset (header, 0, BLOCK_SECTOR_SIZE);
-  block_write (src, 0, header);
-  block_write (src, 1, header);
+  memset (stream.buffer, 0, BLOCK_SECTOR_SIZE);
+  block_write (stream.block, 0, stream.buffer);
+  block_write (stream.block, 1, stream.buffer);
 
-  free (data);
-  free (header);
+  palloc_free_multiple (stream.buffer, EXTRACT_PAGES);
 }
 
 /* Copies file FILE_NAME from the file system to the scratch
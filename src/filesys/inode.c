@@ -1,15 +1,35 @@
 #include "filesys/inode.h"
+#include <bitmap.h>
 #include <list.h>
 #include <debug.h>
 #include <round.h>
+#include <stdio.h>
 #include <string.h>
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "filesys/journal.h"
 #include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/* Bits in inode_disk's `flags' member. */
+#define INODE_INLINE 0x1        /* Data lives in inline_data, not in
+                                   separate data sectors. */
+
+/* Largest file, in bytes, whose data is stored inside its inode
+   sector instead of in data sectors of its own. */
+#define INODE_INLINE_MAX (BLOCK_SECTOR_SIZE - 4 * sizeof (uint32_t))
+
+/* Number of sectors that inode_create() zeroes per disk
+   request. */
+#define ZERO_SECTORS 16
+
+/* Number of pages of data that inode_copy() moves at a time. */
+#define COPY_PAGES 8
+
 /* On-disk inode.
    Must be exactly BLOCK_SECTOR_SIZE bytes long. */
 struct inode_disk
@@ -17,7 +37,8 @@ struct inode_disk
     block_sector_t start;               /* First data sector. */
     off_t length;                       /* File size in bytes. */
     unsigned magic;                     /* Magic number. */
-    uint32_t unused[125];               /* Not used. */
+    uint32_t flags;                     /* INODE_* bits. */
+    uint8_t inline_data[INODE_INLINE_MAX]; /* Data, if INODE_INLINE. */
   };
 
 /* Returns the number of sectors to allocate for an inode SIZE
@@ -28,6 +49,14 @@ bytes_to_sectors (off_t size)
   return DIV_ROUND_UP (size, BLOCK_SECTOR_SIZE);
 }
 
+/* Returns true if DISK_INODE keeps its data inside the inode
+   sector itself. */
+static inline bool
+is_inline (const struct inode_disk *disk_inode)
+{
+  return (disk_inode->flags & INODE_INLINE) != 0;
+}
+
 /* In-memory inode. */
 struct inode 
   {
@@ -47,6 +76,7 @@ static block_sector_t
 byte_to_sector (const struct inode *inode, off_t pos) 
 {
   ASSERT (inode != NULL);
+  ASSERT (!is_inline (&inode->data));
   if (pos < inode->data.length)
     return inode->data.start + pos / BLOCK_SECTOR_SIZE;
   else
@@ -66,7 +96,8 @@ inode_init (void)
 
 /* Initializes an inode with LENGTH bytes of data and
    writes the new inode to sector SECTOR on the file system
-   device.
+   device.  Files of at most INODE_INLINE_MAX bytes are stored
+   inline in the inode sector and use no data sectors at all.
    Returns true if successful.
    Returns false if memory or disk allocation fails. */
 bool
@@ -87,16 +118,25 @@ inode_create (block_sector_t sector, off_t length)
       size_t sectors = bytes_to_sectors (length);
       disk_inode->length = length;
       disk_inode->magic = INODE_MAGIC;
-      if (free_map_allocate (sectors, &disk_inode->start)) 
+      if (length <= (off_t) INODE_INLINE_MAX)
         {
-          block_write (fs_device, sector, disk_inode);
-          if (sectors > 0) 
+          /* calloc() already zeroed the inline data. */
+          disk_inode->flags = INODE_INLINE;
+          journal_write (sector, disk_inode);
+          success = true;
+        }
+      else if (free_map_allocate (sectors, &disk_inode->start)) 
+        {
+          static char zeros[ZERO_SECTORS * BLOCK_SECTOR_SIZE];
+          size_t i;
+
+          journal_write (sector, disk_inode);
+          for (i = 0; i < sectors; i += ZERO_SECTORS) 
             {
-              static char zeros[BLOCK_SECTOR_SIZE];
-              size_t i;
-              
-              for (i = 0; i < sectors; i++) 
-                block_write (fs_device, disk_inode->start + i, zeros);
+              size_t cnt = sectors - i;
+              if (cnt > ZERO_SECTORS)
+                cnt = ZERO_SECTORS;
+              journal_write_data_multi (disk_inode->start + i, cnt, zeros);
             }
           success = true; 
         } 
@@ -137,7 +177,7 @@ inode_open (block_sector_t sector)
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
-  block_read (fs_device, inode->sector, &inode->data);
+  journal_read (inode->sector, &inode->data);
   return inode;
 }
 
@@ -176,9 +216,12 @@ inode_close (struct inode *inode)
       /* Deallocate blocks if removed. */
       if (inode->removed) 
         {
+          journal_begin ();
           free_map_release (inode->sector, 1);
-          free_map_release (inode->data.start,
-                            bytes_to_sectors (inode->data.length)); 
+          if (!is_inline (&inode->data))
+            free_map_release (inode->data.start,
+                              bytes_to_sectors (inode->data.length)); 
+          journal_end ();
         }
 
       free (inode); 
@@ -194,6 +237,22 @@ inode_remove (struct inode *inode)
   inode->removed = true;
 }
 
+/* Reads the SIZE bytes at sector-aligned OFFSET in INODE, which
+   must all lie within INODE's data sectors, straight into
+   BUFFER.  SIZE is rounded up to a whole number of sectors, so
+   BUFFER must have room for that many bytes. */
+static void
+read_sectors (const struct inode *inode, off_t offset, off_t size,
+              void *buffer)
+{
+  ASSERT (offset % BLOCK_SECTOR_SIZE == 0);
+
+  /* Data sectors are contiguous on disk, so this is a single
+     device request. */
+  journal_read_multi (byte_to_sector (inode, offset),
+                      bytes_to_sectors (size), buffer);
+}
+
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
    Returns the number of bytes actually read, which may be less
    than SIZE if an error occurs or end of file is reached. */
@@ -204,6 +263,17 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
   off_t bytes_read = 0;
   uint8_t *bounce = NULL;
 
+  if (is_inline (&inode->data))
+    {
+      /* The data is already in memory, in our copy of the inode. */
+      off_t inode_left = inode_length (inode) - offset;
+      bytes_read = size < inode_left ? size : inode_left;
+      if (bytes_read <= 0)
+        return 0;
+      memcpy (buffer, inode->data.inline_data + offset, bytes_read);
+      return bytes_read;
+    }
+
   while (size > 0) 
     {
       /* Disk sector to read, starting byte offset within sector. */
@@ -222,8 +292,11 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
 
       if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
         {
-          /* Read full sector directly into caller's buffer. */
-          block_read (fs_device, sector_idx, buffer + bytes_read);
+          /* Read the whole run of full sectors directly into
+             caller's buffer. */
+          off_t run_left = size < inode_left ? size : inode_left;
+          chunk_size = run_left / BLOCK_SECTOR_SIZE * BLOCK_SECTOR_SIZE;
+          read_sectors (inode, offset, chunk_size, buffer + bytes_read);
         }
       else 
         {
@@ -235,7 +308,7 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
               if (bounce == NULL)
                 break;
             }
-          block_read (fs_device, sector_idx, bounce);
+          journal_read (sector_idx, bounce);
           memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
         }
       
@@ -249,6 +322,35 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
   return bytes_read;
 }
 
+/* Reads SIZE bytes from INODE into PAGES, starting at position
+   OFFSET, which must be a multiple of BLOCK_SECTOR_SIZE.  Unlike
+   inode_read_at(), PAGES must have room for SIZE rounded up to a
+   whole sector (any page-aligned, page-sized destination does),
+   which lets the final partial sector be read in place too: every
+   sector goes straight from the disk into PAGES, with no bounce
+   buffer.  Bytes past the end of the data actually read are
+   unspecified.
+   Returns the number of bytes actually read, which may be less
+   than SIZE if end of file is reached. */
+off_t
+inode_read_pages (struct inode *inode, void *pages, off_t size, off_t offset)
+{
+  off_t inode_left = inode_length (inode) - offset;
+
+  ASSERT (offset % BLOCK_SECTOR_SIZE == 0);
+
+  if (size > inode_left)
+    size = inode_left;
+  if (size <= 0)
+    return 0;
+
+  if (is_inline (&inode->data))
+    memcpy (pages, inode->data.inline_data + offset, size);
+  else
+    read_sectors (inode, offset, size, pages);
+  return size;
+}
+
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
    Returns the number of bytes actually written, which may be
    less than SIZE if end of file is reached or an error occurs.
@@ -265,6 +367,19 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
   if (inode->deny_write_cnt)
     return 0;
 
+  if (is_inline (&inode->data))
+    {
+      /* Update our copy of the inode, then write the whole inode
+         sector back, since that's where the data lives. */
+      off_t inode_left = inode_length (inode) - offset;
+      bytes_written = size < inode_left ? size : inode_left;
+      if (bytes_written <= 0)
+        return 0;
+      memcpy (inode->data.inline_data + offset, buffer, bytes_written);
+      journal_write (inode->sector, &inode->data);
+      return bytes_written;
+    }
+
   while (size > 0) 
     {
       /* Sector to write, starting byte offset within sector. */
@@ -283,8 +398,12 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 
       if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
         {
-          /* Write full sector directly to disk. */
-          block_write (fs_device, sector_idx, buffer + bytes_written);
+          /* Write the whole run of full sectors directly to
+             disk. */
+          off_t run_left = size < inode_left ? size : inode_left;
+          chunk_size = run_left / BLOCK_SECTOR_SIZE * BLOCK_SECTOR_SIZE;
+          journal_write_multi (sector_idx, chunk_size / BLOCK_SECTOR_SIZE,
+                               buffer + bytes_written);
         }
       else 
         {
@@ -300,11 +419,11 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
              we're writing, then we need to read in the sector
              first.  Otherwise we start with a sector of all zeros. */
           if (sector_ofs > 0 || chunk_size < sector_left) 
-            block_read (fs_device, sector_idx, bounce);
+            journal_read (sector_idx, bounce);
           else
             memset (bounce, 0, BLOCK_SECTOR_SIZE);
           memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-          block_write (fs_device, sector_idx, bounce);
+          journal_write (sector_idx, bounce);
         }
 
       /* Advance. */
@@ -317,6 +436,52 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
   return bytes_written;
 }
 
+/* Copies SIZE bytes from SRC, starting at SRC_OFS, to DST,
+   starting at DST_OFS, through a kernel buffer of up to
+   COPY_PAGES pages.  inode_read_at() and inode_write_at() move
+   each run of whole sectors in the buffer with a single device
+   request, and inline data is copied straight from memory.
+   Returns the number of bytes actually copied, which may be less
+   than SIZE if end of either file is reached, or -1 if memory is
+   short.  The two ranges must not overlap. */
+off_t
+inode_copy (struct inode *dst, off_t dst_ofs, struct inode *src,
+            off_t src_ofs, off_t size) 
+{
+  size_t page_cnt = COPY_PAGES;
+  uint8_t *buffer;
+  off_t bytes_copied = 0;
+
+  buffer = palloc_get_multiple (0, page_cnt);
+  if (buffer == NULL)
+    {
+      page_cnt = 1;
+      buffer = palloc_get_page (0);
+      if (buffer == NULL)
+        return -1;
+    }
+
+  while (size > 0)
+    {
+      off_t buffer_size = page_cnt * PGSIZE;
+      off_t chunk_size = size < buffer_size ? size : buffer_size;
+      off_t bytes_read = inode_read_at (src, buffer, chunk_size, src_ofs);
+      off_t bytes_written = inode_write_at (dst, buffer, bytes_read,
+                                            dst_ofs);
+
+      /* Advance. */
+      size -= bytes_written;
+      src_ofs += bytes_written;
+      dst_ofs += bytes_written;
+      bytes_copied += bytes_written;
+      if (bytes_written < chunk_size)
+        break;
+    }
+  palloc_free_multiple (buffer, page_cnt);
+
+  return bytes_copied;
+}
+
 /* Disables writes to INODE.
    May be called at most once per inode opener. */
 void
@@ -343,3 +508,133 @@ inode_length (const struct inode *inode)
 {
   return inode->data.length;
 }
+
+/* Checks the on-disk inode in SECTOR for consistency and marks
+   the sectors that it occupies, the inode sector included, in
+   USED.  Prints a message for each problem found.
+   Returns true if the inode is consistent and claims no sector
+   already marked in USED, false otherwise. */
+bool
+inode_check (block_sector_t sector, struct bitmap *used)
+{
+  struct inode_disk *disk_inode;
+  block_sector_t dev_size = block_size (fs_device);
+  bool ok = false;
+
+  if (sector >= dev_size)
+    {
+      printf ("inode %"PRDSNu": sector out of range\n", sector);
+      return false;
+    }
+  if (bitmap_test (used, sector))
+    {
+      printf ("inode %"PRDSNu": sector already in use\n", sector);
+      return false;
+    }
+  bitmap_mark (used, sector);
+
+  disk_inode = malloc (sizeof *disk_inode);
+  if (disk_inode == NULL)
+    return false;
+  journal_read (sector, disk_inode);
+
+  if (disk_inode->magic != INODE_MAGIC)
+    printf ("inode %"PRDSNu": bad magic %08x\n", sector, disk_inode->magic);
+  else if ((disk_inode->flags & ~INODE_INLINE) != 0)
+    printf ("inode %"PRDSNu": unknown flags %08"PRIx32"\n",
+            sector, disk_inode->flags);
+  else if (disk_inode->length < 0)
+    printf ("inode %"PRDSNu": negative length %"PROTd"\n",
+            sector, disk_inode->length);
+  else if (is_inline (disk_inode))
+    {
+      if (disk_inode->length > (off_t) INODE_INLINE_MAX)
+        printf ("inode %"PRDSNu": inline length %"PROTd" too long\n",
+                sector, disk_inode->length);
+      else
+        ok = true;
+    }
+  else
+    {
+      block_sector_t start = disk_inode->start;
+      size_t sectors = bytes_to_sectors (disk_inode->length);
+
+      if (start >= dev_size || sectors > dev_size - start)
+        printf ("inode %"PRDSNu": data sectors %"PRDSNu"+%zu out of range\n",
+                sector, start, sectors);
+      else
+        {
+          /* Mark the data even if it is cross-linked, so that the
+             other owner's sectors are not mistaken for free. */
+          if (bitmap_none (used, start, sectors))
+            ok = true;
+          else
+            printf ("inode %"PRDSNu": data sectors %"PRDSNu"+%zu "
+                    "cross-linked\n", sector, start, sectors);
+          bitmap_set_multiple (used, start, sectors, true);
+        }
+    }
+  free (disk_inode);
+  return ok;
+}
+
+/* Moves INODE's data sectors to the lowest run of free sectors
+   that is big enough to hold them, if that run starts before
+   their current location.  The move is one transaction, and it
+   is committed before the old sectors are released, so that
+   they cannot be reused until the move is durable.  Inodes that
+   some other opener holds open are left alone, since a write
+   through that opener could race with the copy.
+   Returns true if INODE's data was moved, false otherwise. */
+bool
+inode_relocate (struct inode *inode)
+{
+  block_sector_t old_start, new_start;
+  size_t sectors, i;
+  uint8_t *bounce;
+
+  if (is_inline (&inode->data) || inode->open_cnt > 1 || inode->removed)
+    return false;
+  sectors = bytes_to_sectors (inode->data.length);
+  if (sectors == 0)
+    return false;
+  bounce = palloc_get_page (0);
+  if (bounce == NULL)
+    return false;
+
+  journal_begin ();
+  old_start = inode->data.start;
+  if (!free_map_allocate (sectors, &new_start))
+    {
+      journal_end ();
+      palloc_free_page (bounce);
+      return false;
+    }
+  if (new_start > old_start)
+    {
+      /* Nothing lower fits: the data is already where it belongs. */
+      free_map_release (new_start, sectors);
+      journal_end ();
+      palloc_free_page (bounce);
+      return false;
+    }
+
+  /* Copy the data to its new, still unreferenced location, then
+     point the inode at it. */
+  for (i = 0; i < sectors; i += PGSIZE / BLOCK_SECTOR_SIZE)
+    {
+      size_t cnt = sectors - i;
+      if (cnt > PGSIZE / BLOCK_SECTOR_SIZE)
+        cnt = PGSIZE / BLOCK_SECTOR_SIZE;
+      journal_read_multi (old_start + i, cnt, bounce);
+      journal_write_data_multi (new_start + i, cnt, bounce);
+    }
+  inode->data.start = new_start;
+  journal_write (inode->sector, &inode->data);
+  journal_flush ();
+  free_map_release (old_start, sectors);
+  journal_end ();
+
+  palloc_free_page (bounce);
+  return true;
+}
@@ -0,0 +1,469 @@
+#include "filesys/journal.h"
+#include <debug.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/filesys.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* A write-ahead journal for file system metadata.
+
+   Metadata updates made between journal_begin() and
+   journal_end() (inode sectors, directory entries, free map
+   sectors) are not written in place.  Instead, the latest image
+   of each modified sector is kept in memory, and the images of
+   many transactions are gathered into a single "group".  The
+   group is committed by writing all of its images sequentially
+   into the log area that starts just after the journal header,
+   then writing the header, which names each image's home
+   sector.  The header write is the commit point.  Only then are
+   the images copied to their home sectors, after which the
+   header is cleared again.  A group is also committed every
+   JOURNAL_COMMIT_TICKS, however full it is, so a finished
+   transaction reaches the disk within that time.
+
+   After a crash, journal_recover() finds a committed but
+   unfinished group in the header and replays it, so either all
+   of a group's updates reach their home sectors or none do.
+
+   All reads and writes of the file system device by the inode
+   layer go through journal_read() and journal_write*(), so that
+   sectors with pending images are never read stale from disk,
+   nor overwritten on disk by data that the checkpoint would
+   later clobber. */
+
+/* Identifies a journal header. */
+#define JOURNAL_MAGIC 0x4a524e4c
+
+/* Commit the group once fewer than this many free records
+   remain, so that the next transaction is likely to fit. */
+#define JOURNAL_TXN_RESERVE 16
+
+/* Commit the group at least this often. */
+#define JOURNAL_COMMIT_TICKS (5 * TIMER_FREQ)
+
+/* On-disk journal header.
+   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+struct journal_header
+  {
+    unsigned magic;                     /* Magic number. */
+    uint32_t record_cnt;                /* Committed records, 0 if clean. */
+    block_sector_t home[JOURNAL_MAX_RECORDS]; /* Home of each record. */
+  };
+
+/* True if the file system device has a journal we may use. */
+static bool enabled;
+
+/* The group being built: home sectors and sector images.
+   IMAGES is allocated only once a journal is found. */
+static struct journal_header group;
+static uint8_t *images;
+
+/* Incremented by each commit, so that a reader that went to the
+   disk without the journal lock can tell whether pending images
+   it missed have been checkpointed meanwhile. */
+static unsigned commit_gen;
+
+/* Serializes transactions and access to the group.
+   Transactions may nest within a single thread, as when closing
+   a removed inode in the middle of another operation, so we
+   track the nesting depth ourselves. */
+static struct lock journal_lock;
+static int journal_depth;
+
+static void start (void);
+static void commit (void);
+static thread_func commit_thread NO_RETURN;
+static void write_through (block_sector_t, size_t cnt, const uint8_t *);
+static int find_record (block_sector_t);
+static void acquire_journal (void);
+static void release_journal (void);
+
+/* Returns the image of record IDX in the group. */
+static inline uint8_t *
+record_image (size_t idx)
+{
+  return images + idx * BLOCK_SECTOR_SIZE;
+}
+
+/* Returns the log sector that holds record IDX. */
+static inline block_sector_t
+record_sector (size_t idx)
+{
+  return JOURNAL_SECTOR + 1 + idx;
+}
+
+/* Initializes the journal module.  The journal stays disabled
+   until journal_create() or journal_recover() finds it usable. */
+void
+journal_init (void)
+{
+  ASSERT (sizeof group == BLOCK_SECTOR_SIZE);
+
+  lock_init (&journal_lock);
+  journal_depth = 0;
+  enabled = false;
+  group.magic = JOURNAL_MAGIC;
+  group.record_cnt = 0;
+  commit_gen = 0;
+}
+
+/* Allocates the group's images, if not yet done, and starts
+   journaling. */
+static void
+start (void)
+{
+  static bool thread_started;
+
+  if (images == NULL)
+    images = palloc_get_multiple (PAL_ASSERT,
+                                  DIV_ROUND_UP (JOURNAL_MAX_RECORDS
+                                                * BLOCK_SECTOR_SIZE,
+                                                PGSIZE));
+  enabled = true;
+  if (!thread_started)
+    {
+      thread_create ("journal", PRI_DEFAULT, commit_thread, NULL);
+      thread_started = true;
+    }
+}
+
+/* Commits the group every JOURNAL_COMMIT_TICKS, so that the
+   durability of a transaction does not wait for the group to
+   fill. */
+static void
+commit_thread (void *aux UNUSED) 
+{
+  for (;;)
+    {
+      timer_sleep (JOURNAL_COMMIT_TICKS);
+      if (enabled)
+        journal_flush ();
+    }
+}
+
+/* Returns true if the file system device is large enough to
+   reserve room for a journal. */
+bool
+journal_fits (void)
+{
+  return block_size (fs_device) > 2 * (JOURNAL_SECTOR + JOURNAL_SECTORS);
+}
+
+/* Writes an empty journal to a freshly formatted file system
+   device and starts journaling. */
+void
+journal_create (void)
+{
+  if (!journal_fits ())
+    return;
+
+  group.record_cnt = 0;
+  block_write (fs_device, JOURNAL_SECTOR, &group);
+  start ();
+}
+
+/* Looks for a journal on the file system device and, if it holds
+   a committed group, replays it.  Journaling is enabled if a
+   journal was found.  File systems formatted before the journal
+   existed have none and are simply used without one. */
+void
+journal_recover (void)
+{
+  struct journal_header *h;
+  size_t i;
+
+  if (!journal_fits ())
+    return;
+
+  h = palloc_get_page (PAL_ASSERT);
+  block_read (fs_device, JOURNAL_SECTOR, h);
+  if (h->magic == JOURNAL_MAGIC)
+    {
+      start ();
+      if (h->record_cnt > 0 && h->record_cnt <= JOURNAL_MAX_RECORDS)
+        {
+          /* The group is empty, so its image buffer is free to
+             hold the log while we replay it. */
+          printf ("journal: replaying %"PRIu32" sectors\n", h->record_cnt);
+          block_read_multi (fs_device, record_sector (0), h->record_cnt,
+                            images);
+          for (i = 0; i < h->record_cnt; i++)
+            block_write (fs_device, h->home[i], record_image (i));
+        }
+      group.record_cnt = 0;
+      block_write (fs_device, JOURNAL_SECTOR, &group);
+    }
+  palloc_free_page (h);
+}
+
+/* Commits any pending group and stops journaling. */
+void
+journal_done (void)
+{
+  journal_flush ();
+  enabled = false;
+}
+
+/* Returns true if the file system device has an active journal,
+   whose sectors are therefore in use. */
+bool
+journal_enabled (void)
+{
+  return enabled;
+}
+
+/* Starts a transaction.  Metadata written with journal_write()
+   until the matching journal_end() is committed atomically, as
+   part of a larger group. */
+void
+journal_begin (void)
+{
+  acquire_journal ();
+}
+
+/* Ends a transaction.  The group is committed once it is nearly
+   full, so that many transactions share one sequential log
+   write; journal_flush() forces an earlier commit. */
+void
+journal_end (void)
+{
+  if (journal_depth == 0
+      && group.record_cnt + JOURNAL_TXN_RESERVE > JOURNAL_MAX_RECORDS)
+    commit ();
+  release_journal ();
+}
+
+/* Commits the pending group, if any, to disk. */
+void
+journal_flush (void)
+{
+  acquire_journal ();
+  commit ();
+  release_journal ();
+}
+
+/* Reads SECTOR of the file system device into BUFFER, which must
+   have room for BLOCK_SECTOR_SIZE bytes, seeing any pending
+   update to it. */
+void
+journal_read (block_sector_t sector, void *buffer)
+{
+  journal_read_multi (sector, 1, buffer);
+}
+
+/* Reads the CNT sectors starting at SECTOR of the file system
+   device into BUFFER, which must have room for CNT *
+   BLOCK_SECTOR_SIZE bytes, seeing any pending updates to them.
+   The whole run is read from disk at once, without the journal
+   lock, so that reads do not wait for each other, and pending
+   images are then copied over the stale sectors.  If a commit
+   checkpointed images in between, the disk read may have missed
+   them, so it is done again. */
+void
+journal_read_multi (block_sector_t sector, size_t cnt, void *buffer_)
+{
+  uint8_t *buffer = buffer_;
+  unsigned gen;
+  bool stale;
+  size_t i;
+
+  if (!enabled)
+    {
+      block_read_multi (fs_device, sector, cnt, buffer);
+      return;
+    }
+
+  do
+    {
+      gen = commit_gen;
+      barrier ();
+      block_read_multi (fs_device, sector, cnt, buffer);
+
+      acquire_journal ();
+      stale = commit_gen != gen;
+      if (!stale)
+        for (i = 0; i < group.record_cnt; i++)
+          if (group.home[i] >= sector && group.home[i] - sector < cnt)
+            memcpy (buffer + (group.home[i] - sector) * BLOCK_SECTOR_SIZE,
+                    record_image (i), BLOCK_SECTOR_SIZE);
+      release_journal ();
+    }
+  while (stale);
+}
+
+/* Writes metadata BUFFER, which must contain BLOCK_SECTOR_SIZE
+   bytes, to SECTOR of the file system device.  Within a
+   transaction the write becomes part of the pending group;
+   otherwise it behaves like journal_write_data(). */
+void
+journal_write (block_sector_t sector, const void *buffer)
+{
+  journal_write_multi (sector, 1, buffer);
+}
+
+/* Writes metadata BUFFER, which must contain CNT *
+   BLOCK_SECTOR_SIZE bytes, to the CNT sectors starting at SECTOR
+   of the file system device, as journal_write() would write each
+   of them. */
+void
+journal_write_multi (block_sector_t sector, size_t cnt, const void *buffer_)
+{
+  const uint8_t *buffer = buffer_;
+  size_t i;
+
+  if (!enabled)
+    {
+      block_write_multi (fs_device, sector, cnt, buffer);
+      return;
+    }
+
+  acquire_journal ();
+  if (journal_depth == 0)
+    {
+      /* Not in a transaction. */
+      write_through (sector, cnt, buffer);
+    }
+  else
+    for (i = 0; i < cnt; i++)
+      {
+        int idx = find_record (sector + i);
+        if (idx < 0)
+          {
+            /* If this transaction alone filled the group, commit
+               what we have.  The transaction is then no longer
+               atomic, but it still reaches the disk in order. */
+            if (group.record_cnt >= JOURNAL_MAX_RECORDS)
+              commit ();
+            idx = group.record_cnt++;
+            group.home[idx] = sector + i;
+          }
+        memcpy (record_image (idx), buffer + i * BLOCK_SECTOR_SIZE,
+                BLOCK_SECTOR_SIZE);
+      }
+  release_journal ();
+}
+
+/* Writes file data BUFFER, which must contain BLOCK_SECTOR_SIZE
+   bytes, to SECTOR of the file system device.  File data is not
+   journaled: it goes straight to disk.  If SECTOR still has a
+   pending metadata image (because it was freed and reallocated
+   within the pending group), only the image is updated, so the
+   checkpoint writes the new data in order. */
+void
+journal_write_data (block_sector_t sector, const void *buffer)
+{
+  journal_write_data_multi (sector, 1, buffer);
+}
+
+/* Writes file data BUFFER, which must contain CNT *
+   BLOCK_SECTOR_SIZE bytes, to the CNT sectors starting at SECTOR
+   of the file system device, as journal_write_data() would write
+   each of them, but with a single device request. */
+void
+journal_write_data_multi (block_sector_t sector, size_t cnt,
+                          const void *buffer)
+{
+  if (!enabled)
+    {
+      block_write_multi (fs_device, sector, cnt, buffer);
+      return;
+    }
+
+  acquire_journal ();
+  write_through (sector, cnt, buffer);
+  release_journal ();
+}
+
+/* Writes BUFFER, which must contain CNT * BLOCK_SECTOR_SIZE
+   bytes, to the CNT sectors starting at SECTOR.  A sector with a
+   pending image only has its image updated, since writing its
+   home before the group commits would break write-ahead order;
+   runs of the other sectors go straight to disk.  The journal
+   lock must be held. */
+static void
+write_through (block_sector_t sector, size_t cnt, const uint8_t *buffer)
+{
+  size_t run = 0;
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&journal_lock));
+
+  for (i = 0; i < cnt; i++)
+    {
+      int idx = find_record (sector + i);
+      if (idx >= 0)
+        {
+          if (i > run)
+            block_write_multi (fs_device, sector + run, i - run,
+                               buffer + run * BLOCK_SECTOR_SIZE);
+          memcpy (record_image (idx), buffer + i * BLOCK_SECTOR_SIZE,
+                  BLOCK_SECTOR_SIZE);
+          run = i + 1;
+        }
+    }
+  if (cnt > run)
+    block_write_multi (fs_device, sector + run, cnt - run,
+                       buffer + run * BLOCK_SECTOR_SIZE);
+}
+
+/* Commits the pending group: writes the log, then the header as
+   the commit record, then each image to its home, and finally
+   clears the header.  The journal lock must be held. */
+static void
+commit (void)
+{
+  size_t cnt = group.record_cnt;
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&journal_lock));
+
+  if (cnt == 0)
+    return;
+
+  block_write_multi (fs_device, record_sector (0), cnt, images);
+  block_write (fs_device, JOURNAL_SECTOR, &group);
+
+  for (i = 0; i < cnt; i++)
+    block_write (fs_device, group.home[i], record_image (i));
+  group.record_cnt = 0;
+  block_write (fs_device, JOURNAL_SECTOR, &group);
+  commit_gen++;
+}
+
+/* Returns the index of the pending record for SECTOR, or -1 if
+   there is none.  The journal lock must be held. */
+static int
+find_record (block_sector_t sector)
+{
+  size_t i;
+
+  for (i = 0; i < group.record_cnt; i++)
+    if (group.home[i] == sector)
+      return i;
+  return -1;
+}
+
+/* Acquires the journal lock, or deepens our hold on it. */
+static void
+acquire_journal (void)
+{
+  if (lock_held_by_current_thread (&journal_lock))
+    journal_depth++;
+  else
+    lock_acquire (&journal_lock);
+}
+
+/* Releases one level of our hold on the journal lock. */
+static void
+release_journal (void)
+{
+  if (journal_depth > 0)
+    journal_depth--;
+  else
+    lock_release (&journal_lock);
+}
@@ -0,0 +1,36 @@
+#ifndef FILESYS_JOURNAL_H
+#define FILESYS_JOURNAL_H
+
+#include <stdbool.h>
+#include "devices/block.h"
+
+/* Most sectors that one group commit can carry.  The journal
+   header sector lists their home locations, so this is however
+   many sector numbers fit beside the header's other fields. */
+#define JOURNAL_MAX_RECORDS (BLOCK_SECTOR_SIZE / sizeof (block_sector_t) - 2)
+
+/* Sectors reserved for the journal, starting at JOURNAL_SECTOR:
+   the header followed by one log sector per record. */
+#define JOURNAL_SECTORS (1 + JOURNAL_MAX_RECORDS)
+
+void journal_init (void);
+bool journal_fits (void);
+void journal_create (void);
+void journal_recover (void);
+void journal_done (void);
+bool journal_enabled (void);
+
+/* Transactions. */
+void journal_begin (void);
+void journal_end (void);
+void journal_flush (void);
+
+/* Journal-aware file system device access. */
+void journal_read (block_sector_t, void *);
+void journal_read_multi (block_sector_t, size_t cnt, void *);
+void journal_write (block_sector_t, const void *);
+void journal_write_multi (block_sector_t, size_t cnt, const void *);
+void journal_write_data (block_sector_t, const void *);
+void journal_write_data_multi (block_sector_t, size_t cnt, const void *);
+
+#endif /* filesys/journal.h */
@@ -3,120 +3,79 @@
 #include <stdio.h>
 #include "devices/serial.h"
 #include "devices/vga.h"
-#include "threads/init.h"
 #include "threads/interrupt.h"
-#include "threads/synch.h"
+#include "threads/thread.h"
 
-static void vprintf_helper (char, void *);
-static void putchar_have_lock (uint8_t c);
-
-/* The console lock.
-   Both the vga and serial layers do their own locking, so it's
-   safe to call them at any time.
-   But this lock is useful to prevent simultaneous printf() calls
-   from mixing their output, which looks confusing. */
-static struct lock console_lock;
-
-/* True in ordinary circumstances: we want to use the console
-   lock to avoid mixing output between threads, as explained
-   above.
-
-   False in early boot before the point that locks are functional
-   or the console lock has been initialized, or after a kernel
-   panics.  In the former case, taking the lock would cause an
-   assertion failure, which in turn would cause a panic, turning
-   it into the latter case.  In the latter case, if it is a buggy
-   lock_acquire() implementation that caused the panic, we'll
-   likely just recurse. */
-static bool use_console_lock;
-
-/* It's possible, if you add enough debug output to Pintos, to
-   try to recursively grab console_lock from a single thread.  As
-   a real example, I added a printf() call to palloc_free().
-   Here's a real backtrace that resulted:
-
-   lock_console()
-   vprintf()
-   printf()               - palloc() tries to grab the lock again
-   palloc_free()        
-   thread_schedule_tail() - another thread dying as we switch threads
-   schedule()
-   thread_yield()
-   intr_handler()         - timer interrupt
-   intr_set_level()
-   serial_putc()
-   putchar_have_lock()
-   putbuf()
-   sys_write()            - one process writing to the console
-   syscall_handler()
-   intr_handler()
-
-   This kind of thing is very difficult to debug, so we avoid the
-   problem by simulating a recursive lock with a depth
-   counter. */
-static int console_lock_depth;
+/* Console output is line buffered per thread.  Each thread
+   gathers what it prints into the line buffer in its struct
+   thread and writes out each line whole, with interrupts
+   disabled, once it ends the line or fills the buffer.  Lines
+   printed by different threads thus never mix, yet no lock is
+   needed: only a thread itself touches its buffer, and writing a
+   line to the serial port only queues it for the serial
+   interrupt handler to send.
+
+   Doing without a lock also means that a printf() in an
+   unexpected place, such as palloc_free() called while another
+   thread's output is being written, cannot deadlock or recurse
+   on the console.
+
+   Output from interrupt handlers, from early boot before
+   console_init(), and after a kernel panic bypasses the line
+   buffers and is written at once. */
+
+/* True if threads' output goes through their line buffers. */
+static bool use_line_buffers;
 
 /* Number of characters written to console. */
 static int64_t write_cnt;
 
-/* Enable console locking. */
+/* Auxiliary data for vprintf_helper(). */
+struct vprintf_aux
+  {
+    struct thread *t;           /* Buffering thread, or null. */
+    int char_cnt;               /* Number of characters output. */
+  };
+
+static void vprintf_helper (char, void *);
+static struct thread *buffering_thread (void);
+static void put_char (struct thread *, uint8_t c);
+static void flush_line (struct thread *);
+static void write_direct (const char *, size_t);
+
+/* Enable line buffering. */
 void
 console_init (void) 
 {
-  lock_init (&console_lock);
-  use_console_lock = true;
+  use_line_buffers = true;
 }
 
-/* Notifies the console that a kernel panic is underway,
-   which warns it to avoid trying to take the console lock from
-   now on. */
+/* Notifies the console that a kernel panic is underway, which
+   warns it to stop buffering output from now on.  A partial line
+   buffered by the panicking thread is lost: the thread may be in
+   no state for thread_current() to find it, and a failed
+   assertion there would only turn this panic into a recursive
+   one. */
 void
 console_panic (void) 
 {
-  use_console_lock = false;
+  use_line_buffers = false;
 }
 
-/* Prints console statistics. */
+/* Writes out the current thread's partial line, if any. */
 void
-console_print_stats (void) 
+console_flush (void) 
 {
-  printf ("Console: %lld characters output\n", write_cnt);
+  struct thread *t = buffering_thread ();
+  if (t != NULL)
+    flush_line (t);
 }
 
-/* Acquires the console lock. */
-static void
-acquire_console (void) 
-{
-  if (!intr_context () && use_console_lock) 
-    {
-      if (lock_held_by_current_thread (&console_lock)) 
-        console_lock_depth++; 
-      else
-        lock_acquire (&console_lock); 
-    }
-}
-
-/* Releases the console lock. */
-static void
-release_console (void) 
-{
-  if (!intr_context () && use_console_lock) 
-    {
-      if (console_lock_depth > 0)
-        console_lock_depth--;
-      else
-        lock_release (&console_lock); 
-    }
-}
-
-/* Returns true if the current thread has the console lock,
-   false otherwise. */
-static bool
-console_locked_by_current_thread (void) 
+/* Prints console statistics. */
+void
+console_print_stats (void) 
 {
-  return (intr_context ()
-          || !use_console_lock
-          || lock_held_by_current_thread (&console_lock));
+  printf ("Console: %lld characters output\n", write_cnt);
 }
 
 /* The standard vprintf() function,
@@ -125,13 +84,13 @@ console_locked_by_current_thread (void)
 int
 vprintf (const char *format, va_list args) 
 {
-  int char_cnt = 0;
+  struct vprintf_aux aux;
 
-  acquire_console ();
-  __vprintf (format, args, vprintf_helper, &char_cnt);
-  release_console ();
+  aux.t = buffering_thread ();
+  aux.char_cnt = 0;
+  __vprintf (format, args, vprintf_helper, &aux);
 
-  return char_cnt;
+  return aux.char_cnt;
 }
 
 /* Writes string S to the console, followed by a new-line
@@ -139,53 +98,100 @@ vprintf (const char *format, va_list args)
 int
 puts (const char *s) 
 {
-  acquire_console ();
+  struct thread *t = buffering_thread ();
+
   while (*s != '\0')
-    putchar_have_lock (*s++);
-  putchar_have_lock ('\n');
-  release_console ();
+    put_char (t, *s++);
+  put_char (t, '\n');
 
   return 0;
 }
 
-/* Writes the N characters in BUFFER to the console. */
+/* Writes the N characters in BUFFER to the console, along with
+   any partial line printed before them.  Unlike the other output
+   functions, does not leave a partial line buffered, so that,
+   e.g., a user program's prompt appears before it reads its
+   input. */
 void
 putbuf (const char *buffer, size_t n) 
 {
-  acquire_console ();
+  struct thread *t = buffering_thread ();
+
+  if (t == NULL)
+    {
+      write_direct (buffer, n);
+      return;
+    }
   while (n-- > 0)
-    putchar_have_lock (*buffer++);
-  release_console ();
+    put_char (t, *buffer++);
+  flush_line (t);
 }
 
 /* Writes C to the vga display and serial port. */
 int
 putchar (int c) 
 {
-  acquire_console ();
-  putchar_have_lock (c);
-  release_console ();
+  put_char (buffering_thread (), c);
   
   return c;
 }
-
+
 /* Helper function for vprintf(). */
 static void
-vprintf_helper (char c, void *char_cnt_) 
+vprintf_helper (char c, void *aux_) 
+{
+  struct vprintf_aux *aux = aux_;
+  aux->char_cnt++;
+  put_char (aux->t, c);
+}
+
+/* Returns the thread whose line buffer output should go to, or
+   a null pointer if output should be written at once. */
+static struct thread *
+buffering_thread (void) 
 {
-  int *char_cnt = char_cnt_;
-  (*char_cnt)++;
-  putchar_have_lock (c);
+  return use_line_buffers && !intr_context () ? thread_current () : NULL;
+}
+
+/* Adds C to T's line buffer, writing out the line if C ends it
+   or the buffer is full.  If T is null, writes C at once. */
+static void
+put_char (struct thread *t, uint8_t c) 
+{
+  if (t == NULL)
+    {
+      char ch = c;
+      write_direct (&ch, 1);
+      return;
+    }
+
+  t->console_line[t->console_len++] = c;
+  if (c == '\n' || t->console_len >= sizeof t->console_line)
+    flush_line (t);
+}
+
+/* Writes out and empties T's line buffer. */
+static void
+flush_line (struct thread *t) 
+{
+  size_t n = t->console_len;
+
+  t->console_len = 0;
+  if (n > 0)
+    write_direct (t->console_line, n);
 }
 
-/* Writes C to the vga display and serial port.
-   The caller has already acquired the console lock if
-   appropriate. */
+/* Writes the N characters in BUFFER to the vga display and
+   serial port, without interruption by other output. */
 static void
-putchar_have_lock (uint8_t c) 
+write_direct (const char *buffer, size_t n) 
 {
-  ASSERT (console_locked_by_current_thread ());
-  write_cnt++;
-  serial_putc (c);
-  vga_putc (c);
+  enum intr_level old_level = intr_disable ();
+  size_t i;
+
+  write_cnt += n;
+  serial_putbuf (buffer, n);
+  for (i = 0; i < n; i++)
+    vga_putc ((uint8_t) buffer[i]);
+  intr_set_level (old_level);
 }
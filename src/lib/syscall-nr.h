@@ -28,7 +28,25 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+
+    /* Extensions. */
+    SYS_MONOTIME,               /* Nanoseconds since boot. */
+    SYS_DUP,                    /* Duplicate a file descriptor. */
+    SYS_DUP2,                   /* Duplicate onto a given descriptor. */
+    SYS_PREAD,                  /* Read from a file at an offset. */
+    SYS_PWRITE,                 /* Write to a file at an offset. */
+    SYS_READV,                  /* Read into several buffers. */
+    SYS_WRITEV,                 /* Write from several buffers. */
+    SYS_COPY_FILE_RANGE,        /* Copy between files in the kernel. */
+    SYS_PIPE,                   /* Create a pipe. */
+    SYS_SET_CLOEXEC,            /* Keep a descriptor from exec(). */
+    SYS_SHM_CREATE,             /* Create a shared memory segment. */
+    SYS_SHM_ATTACH,             /* Map a shared memory segment. */
+    SYS_SHM_DETACH,             /* Unmap a shared memory segment. */
+    SYS_FUTEX,                  /* Wait on or wake a futex. */
+    SYS_THREAD_CREATE,          /* Start a thread in this process. */
+    SYS_THREAD_JOIN             /* Wait for a thread to exit. */
   };
 
 #endif /* lib/syscall-nr.h */
@@ -0,0 +1,77 @@
+#include <mutex.h>
+#include <syscall.h>
+
+/* A mutex is a futex in one of three states: free (0), held with
+   no waiters (1), or held with possible waiters (2).  Taking a
+   free mutex and releasing one with no waiters are each a single
+   atomic instruction; only a thread that must sleep, or one that
+   releases a mutex others may be sleeping on, calls the kernel.
+   See Ulrich Drepper, "Futexes Are Tricky". */
+
+/* If *P == OLD, atomically sets *P to NEW.  Either way, returns
+   the old value of *P. */
+static inline int
+cmpxchg (int *p, int old, int new) 
+{
+  int prev;
+  asm volatile ("lock cmpxchgl %2, %1"
+                : "=a" (prev), "+m" (*p)
+                : "r" (new), "0" (old)
+                : "memory");
+  return prev;
+}
+
+/* Atomically sets *P to NEW and returns its old value. */
+static inline int
+xchg (int *p, int new) 
+{
+  asm volatile ("xchgl %0, %1"
+                : "+r" (new), "+m" (*p)
+                :
+                : "memory");
+  return new;
+}
+
+/* Initializes M as free. */
+void
+mutex_init (struct mutex *m) 
+{
+  m->state = 0;
+}
+
+/* Acquires M, sleeping until it is free if need be. */
+void
+mutex_lock (struct mutex *m) 
+{
+  int c = cmpxchg (&m->state, 0, 1);
+  if (c == 0)
+    return;
+
+  /* Mark M contended before sleeping, so that its holder wakes
+     us when it releases it.  We cannot know whether others still
+     wait once we have it, so we keep it marked contended. */
+  if (c != 2)
+    c = xchg (&m->state, 2);
+  while (c != 0)
+    {
+      futex (&m->state, FUTEX_WAIT, 2);
+      c = xchg (&m->state, 2);
+    }
+}
+
+/* Acquires M if it is free, without sleeping.  Returns true if
+   successful, false if M was held. */
+bool
+mutex_trylock (struct mutex *m) 
+{
+  return cmpxchg (&m->state, 0, 1) == 0;
+}
+
+/* Releases M, which the caller must hold, and wakes one thread
+   waiting for it, if any. */
+void
+mutex_unlock (struct mutex *m) 
+{
+  if (xchg (&m->state, 0) == 2)
+    futex (&m->state, FUTEX_WAKE, 1);
+}
@@ -0,0 +1,20 @@
+#ifndef __LIB_USER_MUTEX_H
+#define __LIB_USER_MUTEX_H
+
+#include <stdbool.h>
+
+/* A mutual exclusion lock built on futex().  Initialize with
+   MUTEX_INITIALIZER or mutex_init(). */
+struct mutex
+  {
+    int state;                  /* 0: free, 1: held, 2: held, maybe waiters. */
+  };
+
+#define MUTEX_INITIALIZER { 0 }
+
+void mutex_init (struct mutex *);
+void mutex_lock (struct mutex *);
+bool mutex_trylock (struct mutex *);
+void mutex_unlock (struct mutex *);
+
+#endif /* lib/user/mutex.h */
@@ -1,31 +1,52 @@
 #include <syscall.h>
 #include "../syscall-nr.h"
 
+/* True if system calls enter the kernel with sysenter, false if
+   they use int $0x30.  See syscall_set_sysenter(). */
+static bool use_sysenter;
+
+/* Enters the kernel, with the system call number and arguments
+   already pushed on the stack, by sysenter if USE_SYSENTER
+   (operand %[fast]) is true, otherwise by int $0x30.  The kernel
+   finds the arguments at the same place either way.  Sysenter
+   passes the kernel the address to return to in EDX and our
+   stack pointer in ECX, so both registers are clobbered. */
+#define SYSCALL_TRAP                                            \
+        "cmpb $0, %[fast]; je 2f; "                             \
+        "movl %%esp, %%ecx; movl $1f, %%edx; sysenter; "        \
+        "2: int $0x30; 1: "
+
 /* Invokes syscall NUMBER, passing no arguments, and returns the
    return value as an `int'. */
 #define syscall0(NUMBER)                                        \
         ({                                                      \
           int retval;                                           \
           asm volatile                                          \
-            ("pushl %[number]; int $0x30; addl $4, %%esp"       \
+            ("pushl %[number]; " SYSCALL_TRAP "addl $4, %%esp"  \
                : "=a" (retval)                                  \
-               : [number] "i" (NUMBER)                          \
-               : "memory");                                     \
+               : [number] "i" (NUMBER),                         \
+                 [fast] "m" (use_sysenter)                      \
+               : "ecx", "edx", "cc", "memory");                 \
           retval;                                               \
         })
 
 /* Invokes syscall NUMBER, passing argument ARG0, and returns the
-   return value as an `int'. */
-#define syscall1(NUMBER, ARG0)                                           \
-        ({                                                               \
-          int retval;                                                    \
-          asm volatile                                                   \
-            ("pushl %[arg0]; pushl %[number]; int $0x30; addl $8, %%esp" \
-               : "=a" (retval)                                           \
-               : [number] "i" (NUMBER),                                  \
-                 [arg0] "g" (ARG0)                                       \
-               : "memory");                                              \
-          retval;                                                        \
+   return value as an `int'.
+
+   The arguments are register ("r") operands: a memory operand
+   could be addressed relative to ESP, which the pushes move. */
+#define syscall1(NUMBER, ARG0)                                  \
+        ({                                                      \
+          int retval;                                           \
+          asm volatile                                          \
+            ("pushl %[arg0]; pushl %[number]; "                 \
+             SYSCALL_TRAP "addl $8, %%esp"                      \
+               : "=a" (retval)                                  \
+               : [number] "i" (NUMBER),                         \
+                 [arg0] "r" (ARG0),                             \
+                 [fast] "m" (use_sysenter)                      \
+               : "ecx", "edx", "cc", "memory");                 \
+          retval;                                               \
         })
 
 /* Invokes syscall NUMBER, passing arguments ARG0 and ARG1, and
@@ -35,12 +56,13 @@
           int retval;                                           \
           asm volatile                                          \
             ("pushl %[arg1]; pushl %[arg0]; "                   \
-             "pushl %[number]; int $0x30; addl $12, %%esp"      \
+             "pushl %[number]; " SYSCALL_TRAP "addl $12, %%esp" \
                : "=a" (retval)                                  \
                : [number] "i" (NUMBER),                         \
-                 [arg0] "g" (ARG0),                             \
-                 [arg1] "g" (ARG1)                              \
-               : "memory");                                     \
+                 [arg0] "r" (ARG0),                             \
+                 [arg1] "r" (ARG1),                             \
+                 [fast] "m" (use_sysenter)                      \
+               : "ecx", "edx", "cc", "memory");                 \
           retval;                                               \
         })
 
@@ -51,16 +73,61 @@
           int retval;                                           \
           asm volatile                                          \
             ("pushl %[arg2]; pushl %[arg1]; pushl %[arg0]; "    \
-             "pushl %[number]; int $0x30; addl $16, %%esp"      \
+             "pushl %[number]; " SYSCALL_TRAP "addl $16, %%esp" \
                : "=a" (retval)                                  \
                : [number] "i" (NUMBER),                         \
-                 [arg0] "g" (ARG0),                             \
-                 [arg1] "g" (ARG1),                             \
-                 [arg2] "g" (ARG2)                              \
-               : "memory");                                     \
+                 [arg0] "r" (ARG0),                             \
+                 [arg1] "r" (ARG1),                             \
+                 [arg2] "r" (ARG2),                             \
+                 [fast] "m" (use_sysenter)                      \
+               : "ecx", "edx", "cc", "memory");                 \
           retval;                                               \
         })
 
+/* Invokes syscall NUMBER, passing arguments ARG0, ARG1, ARG2,
+   and ARG3, and returns the return value as an `int'.  With ECX
+   and EDX clobbered, the four arguments take every other
+   general-purpose register the compiler can give us. */
+#define syscall4(NUMBER, ARG0, ARG1, ARG2, ARG3)                \
+        ({                                                      \
+          int retval;                                           \
+          asm volatile                                          \
+            ("pushl %[arg3]; pushl %[arg2]; pushl %[arg1]; "    \
+             "pushl %[arg0]; pushl %[number]; "                 \
+             SYSCALL_TRAP "addl $20, %%esp"                     \
+               : "=a" (retval)                                  \
+               : [number] "i" (NUMBER),                         \
+                 [arg0] "r" (ARG0),                             \
+                 [arg1] "r" (ARG1),                             \
+                 [arg2] "r" (ARG2),                             \
+                 [arg3] "r" (ARG3),                             \
+                 [fast] "m" (use_sysenter)                      \
+               : "ecx", "edx", "cc", "memory");                 \
+          retval;                                               \
+        })
+
+/* CPUID leaf 1 EDX bit: SYSENTER and SYSEXIT are supported.  The
+   kernel enables sysenter whenever this bit is set, so checking
+   it here tells us whether the kernel accepts sysenter. */
+#define CPUID_SEP (1u << 11)
+
+/* Makes system calls enter the kernel with sysenter, if ENABLE
+   is true and the CPU supports it, or with int $0x30 otherwise.
+   Returns true if system calls now use sysenter.  System calls
+   use sysenter from the start of the program when they can. */
+bool
+syscall_set_sysenter (bool enable) 
+{
+  if (enable)
+    {
+      uint32_t eax = 1, ebx, ecx, edx;
+      asm ("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+      enable = (edx & CPUID_SEP) != 0;
+    }
+  use_sysenter = enable;
+  return use_sysenter;
+}
+
 void
 halt (void) 
 {
@@ -182,3 +249,121 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+/* Returns the number of nanoseconds since boot.  The kernel
+   returns the 64-bit result in EDX:EAX, so this can't use
+   syscall0(), and must use int $0x30, since SYSEXIT returns to
+   the address in EDX. */
+int64_t
+monotime (void) 
+{
+  int64_t retval;
+  asm volatile
+    ("pushl %[number]; int $0x30; addl $4, %%esp"
+       : "=A" (retval)
+       : [number] "i" (SYS_MONOTIME)
+       : "memory");
+  return retval;
+}
+
+int
+dup (int fd) 
+{
+  return syscall1 (SYS_DUP, fd);
+}
+
+int
+dup2 (int old_fd, int new_fd) 
+{
+  return syscall2 (SYS_DUP2, old_fd, new_fd);
+}
+
+int
+pread (int fd, void *buffer, unsigned size, unsigned offset) 
+{
+  return syscall4 (SYS_PREAD, fd, buffer, size, offset);
+}
+
+int
+pwrite (int fd, const void *buffer, unsigned size, unsigned offset) 
+{
+  return syscall4 (SYS_PWRITE, fd, buffer, size, offset);
+}
+
+int
+readv (int fd, const struct iovec *iov, int iovcnt) 
+{
+  return syscall3 (SYS_READV, fd, iov, iovcnt);
+}
+
+int
+writev (int fd, const struct iovec *iov, int iovcnt) 
+{
+  return syscall3 (SYS_WRITEV, fd, iov, iovcnt);
+}
+
+int
+copy_file_range (int in_fd, int out_fd, unsigned length) 
+{
+  return syscall3 (SYS_COPY_FILE_RANGE, in_fd, out_fd, length);
+}
+
+int
+pipe (int fds[2]) 
+{
+  return syscall1 (SYS_PIPE, fds);
+}
+
+bool
+set_cloexec (int fd, bool close_on_exec) 
+{
+  return syscall2 (SYS_SET_CLOEXEC, fd, (int) close_on_exec);
+}
+
+int
+shm_create (void *addr, unsigned length) 
+{
+  return syscall2 (SYS_SHM_CREATE, addr, length);
+}
+
+bool
+shm_attach (int id, void *addr) 
+{
+  return syscall2 (SYS_SHM_ATTACH, id, addr);
+}
+
+bool
+shm_detach (void *addr) 
+{
+  return syscall1 (SYS_SHM_DETACH, addr);
+}
+
+int
+futex (int *addr, int op, int val) 
+{
+  return syscall3 (SYS_FUTEX, addr, op, val);
+}
+
+/* Where a thread started by thread_create() begins.  A thread
+   ends by calling exit(), which ends only the calling thread;
+   returning from FUNCTION does the same with status 0.  When the
+   main thread exits, or any thread faults, every thread ends. */
+static void thread_start (void (*) (void *), void *) NO_RETURN;
+static void
+thread_start (void (*function) (void *), void *aux) 
+{
+  function (aux);
+  exit (0);
+}
+
+tid_t
+thread_create (void (*function) (void *), void *aux) 
+{
+  return syscall3 (SYS_THREAD_CREATE, thread_start, function, aux);
+}
+
+int
+thread_join (tid_t tid) 
+{
+  return syscall1 (SYS_THREAD_JOIN, tid);
+}
@@ -1,13 +1,20 @@
 #ifndef __LIB_USER_SYSCALL_H
 #define __LIB_USER_SYSCALL_H
 
+#include <futex.h>
+#include <iovec.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <debug.h>
 
 /* Process identifier. */
 typedef int pid_t;
 #define PID_ERROR ((pid_t) -1)
 
+/* Thread identifier. */
+typedef int tid_t;
+#define TID_ERROR ((tid_t) -1)
+
 /* Map region identifier. */
 typedef int mapid_t;
 #define MAP_FAILED ((mapid_t) -1)
@@ -45,4 +52,23 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Extensions. */
+int64_t monotime (void);
+int dup (int fd);
+int dup2 (int old_fd, int new_fd);
+int pread (int fd, void *buffer, unsigned length, unsigned offset);
+int pwrite (int fd, const void *buffer, unsigned length, unsigned offset);
+int readv (int fd, const struct iovec *, int iovcnt);
+int writev (int fd, const struct iovec *, int iovcnt);
+int copy_file_range (int in_fd, int out_fd, unsigned length);
+int pipe (int fds[2]);
+bool set_cloexec (int fd, bool close_on_exec);
+int shm_create (void *addr, unsigned length);
+bool shm_attach (int id, void *addr);
+bool shm_detach (void *addr);
+int futex (int *addr, int op, int val);
+tid_t thread_create (void (*function) (void *), void *aux);
+int thread_join (tid_t);
+bool syscall_set_sysenter (bool enable);
+
 #endif /* lib/user/syscall.h */
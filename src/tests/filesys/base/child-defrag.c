@@ -0,0 +1,32 @@
+/* Child process run by the kernel after fsck-defrag, once the
+   file system has been defragmented and checked.  Checks that
+   the odd-numbered files still hold what fsck-defrag wrote and
+   that the even-numbered ones are still gone. */
+
+#include <syscall.h>
+#include "tests/filesys/base/fsck-defrag.h"
+#include "tests/lib.h"
+
+const char *test_name = "child-defrag";
+
+int
+main (void) 
+{
+  char name[16], buf[FILE_SIZE];
+  int i;
+
+  msg ("begin");
+  quiet = true;
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      make_file (i, name, buf);
+      if (i % 2 == 0)
+        CHECK (open (name) == -1, "open \"%s\" must fail", name);
+      else
+        check_file (name, buf, FILE_SIZE);
+    }
+  quiet = false;
+  msg ("verified %d files", FILE_CNT / 2);
+  msg ("end");
+  return 0;
+}
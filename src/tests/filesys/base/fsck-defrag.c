@@ -0,0 +1,40 @@
+/* Fragments the file system's free space by creating a row of
+   files and then removing every other one.  The kernel command
+   line goes on to run "defrag", which must move the remaining
+   files' data down into the holes, and "fsck", which must find
+   the file system sound, and then runs child-defrag to check
+   that the data survived the move. */
+
+#include <syscall.h>
+#include "tests/filesys/base/fsck-defrag.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char name[16], buf[FILE_SIZE];
+  int i, fd;
+
+  quiet = true;
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      make_file (i, name, buf);
+      CHECK (create (name, FILE_SIZE), "create \"%s\"", name);
+      CHECK ((fd = open (name)) > 1, "open \"%s\"", name);
+      CHECK (write (fd, buf, FILE_SIZE) == FILE_SIZE,
+             "write \"%s\"", name);
+      close (fd);
+    }
+  quiet = false;
+  msg ("created %d files", FILE_CNT);
+
+  quiet = true;
+  for (i = 0; i < FILE_CNT; i += 2)
+    {
+      make_file (i, name, buf);
+      CHECK (remove (name), "remove \"%s\"", name);
+    }
+  quiet = false;
+  msg ("removed every other file");
+}
@@ -0,0 +1,32 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fsck-defrag) begin
+(fsck-defrag) created 12 files
+(fsck-defrag) removed every other file
+(fsck-defrag) end
+fsck-defrag: exit(0)
+EOF
+
+# The kernel then ran "defrag", "fsck" and child-defrag.
+our ($test);
+my (@output) = read_text_file ("$test.output");
+fail "defrag didn't move any files\n"
+  if !grep (/^Moved [1-9]\d* files;/, @output);
+my ($i) = grep ($output[$_] eq 'Checking file system...', 0...$#output);
+fail "fsck didn't run\n" if !defined $i;
+fail "fsck didn't find the file system clean\n"
+  if $i == $#output || $output[$i + 1] ne 'File system check done.';
+
+my (@child) = grep (/^\(child-defrag\) |^child-defrag: /, @output);
+my ($expected) = <<'EOF';
+(child-defrag) begin
+(child-defrag) verified 6 files
+(child-defrag) end
+child-defrag: exit(0)
+EOF
+fail "child-defrag output differs from expected:\n", map ("$_\n", @child)
+  if join ('', map ("$_\n", @child)) ne $expected;
+pass;
@@ -0,0 +1,23 @@
+#ifndef TESTS_FILESYS_BASE_FSCK_DEFRAG_H
+#define TESTS_FILESYS_BASE_FSCK_DEFRAG_H
+
+#include <random.h>
+#include <stdio.h>
+
+/* fsck-defrag creates FILE_CNT files of FILE_SIZE bytes each and
+   removes the even-numbered ones.  The root directory has room
+   for 16 entries, two of which hold the test programs. */
+#define FILE_CNT 12
+#define FILE_SIZE 2000
+
+/* Stores the name of file IDX into NAME and its contents into
+   BUF. */
+static inline void
+make_file (int idx, char name[16], char buf[FILE_SIZE]) 
+{
+  snprintf (name, 16, "frag%d", idx);
+  random_init (idx);
+  random_bytes (buf, FILE_SIZE);
+}
+
+#endif /* tests/filesys/base/fsck-defrag.h */
@@ -0,0 +1,22 @@
+/* Writes out files of 496 and 497 bytes, the largest file whose
+   data fits in its inode's sector and the smallest one whose data
+   does not, and reads each back to make sure that it was written
+   properly. */
+
+#include "tests/filesys/seq-test.h"
+#include "tests/main.h"
+
+static char buf[497];
+
+static size_t
+return_buf_size (void) 
+{
+  return sizeof buf;
+}
+
+void
+test_main (void) 
+{
+  seq_test ("inline", buf, 496, 496, return_buf_size, NULL);
+  seq_test ("extent", buf, 497, 497, return_buf_size, NULL);
+}
@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(sm-inline) begin
+(sm-inline) create "inline"
+(sm-inline) open "inline"
+(sm-inline) writing "inline"
+(sm-inline) close "inline"
+(sm-inline) open "inline" for verification
+(sm-inline) verified contents of "inline"
+(sm-inline) close "inline"
+(sm-inline) create "extent"
+(sm-inline) open "extent"
+(sm-inline) writing "extent"
+(sm-inline) close "extent"
+(sm-inline) open "extent" for verification
+(sm-inline) verified contents of "extent"
+(sm-inline) close "extent"
+(sm-inline) end
+EOF
+pass;
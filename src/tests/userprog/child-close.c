@@ -1,11 +1,9 @@
 /* Child process run by multi-child-fd test.
 
-   Attempts to close the file descriptor passed as the first
-   command-line argument.  This is invalid, because file
-   descriptors are not inherited in Pintos.  Two results are
-   allowed: either the system call should return without taking
-   any action, or the kernel should terminate the process with a
-   -1 exit code. */
+   Closes the file descriptor passed as the first command-line
+   argument, which this process inherited from its parent.  That
+   closes only this process's copy, so the parent can go on
+   using the file. */
 
 #include <ctype.h>
 #include <stdio.h>
@@ -0,0 +1,27 @@
+/* Child process run by pipe-reader-exit test.
+
+   Reads 10 bytes from its standard input, which is a pipe, and
+   exits with the number of bytes read, leaving the pipe with no
+   reader. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+
+const char *test_name = "child-pipe-read";
+
+int
+main (void) 
+{
+  char buf[10];
+  int ofs = 0;
+
+  while (ofs < (int) sizeof buf)
+    {
+      int n = read (STDIN_FILENO, buf + ofs, sizeof buf - ofs);
+      if (n <= 0)
+        break;
+      ofs += n;
+    }
+  return ofs;
+}
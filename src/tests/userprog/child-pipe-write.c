@@ -0,0 +1,23 @@
+/* Child process run by pipe-reader-exit test.
+
+   Writes to its standard output, which is a pipe, until a write
+   comes up short because the pipe has no reader left, then exits
+   with status 0. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+
+const char *test_name = "child-pipe-write";
+
+int
+main (void) 
+{
+  char buf[1024];
+
+  memset (buf, 'x', sizeof buf);
+  while (write (STDOUT_FILENO, buf, sizeof buf) == sizeof buf)
+    continue;
+  return 0;
+}
@@ -0,0 +1,41 @@
+/* Child process run by thread-main-exit test.
+
+   Starts one thread that spins and one that sleeps on a futex
+   that is never woken, waits until both are running, and then
+   returns from main(). */
+
+#include <futex.h>
+#include <syscall.h>
+#include "tests/lib.h"
+
+const char *test_name = "child-thread-exit";
+
+static volatile int started;
+static int never;
+
+static void
+spin (void *aux UNUSED) 
+{
+  started++;
+  for (;;)
+    continue;
+}
+
+static void
+sleep_forever (void *aux UNUSED) 
+{
+  started++;
+  futex (&never, FUTEX_WAIT, 0);
+  exit (1);
+}
+
+int
+main (void) 
+{
+  if (thread_create (spin, NULL) == TID_ERROR
+      || thread_create (sleep_forever, NULL) == TID_ERROR)
+    return 2;
+  while (started < 2)
+    continue;
+  return 81;
+}
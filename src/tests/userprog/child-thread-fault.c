@@ -0,0 +1,25 @@
+/* Child process run by thread-fault test.
+
+   Starts a thread that dereferences NULL, then spins without
+   making any system call. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+
+const char *test_name = "child-thread-fault";
+
+static void
+bad_read (void *aux UNUSED) 
+{
+  msg ("Congratulations - you have successfully dereferenced NULL: %d",
+       *(int *) NULL);
+}
+
+int
+main (void) 
+{
+  if (thread_create (bad_read, NULL) == TID_ERROR)
+    return 2;
+  for (;;)
+    continue;
+}
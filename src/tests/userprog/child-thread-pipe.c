@@ -0,0 +1,33 @@
+/* Child process run by thread-pipe-exit test.
+
+   Starts a thread that reads its standard input, a pipe that
+   nobody writes or closes, waits until the thread is about to
+   read, and then returns from main(). */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+
+const char *test_name = "child-thread-pipe";
+
+static volatile int started;
+
+static void
+read_forever (void *aux UNUSED) 
+{
+  char c;
+
+  started = 1;
+  read (STDIN_FILENO, &c, 1);
+  exit (1);
+}
+
+int
+main (void) 
+{
+  if (thread_create (read_forever, NULL) == TID_ERROR)
+    return 2;
+  while (!started)
+    continue;
+  return 82;
+}
@@ -0,0 +1,38 @@
+/* Copies "sample.txt" to "test.txt" with copy_file_range(), in
+   pieces, and checks that both positions advance and that the
+   copy stops at end of file. */
+
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  size_t size = sizeof sample - 1;
+  int in_fd, out_fd, byte_cnt;
+
+  CHECK (create ("test.txt", size), "create \"test.txt\"");
+  CHECK ((in_fd = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK ((out_fd = open ("test.txt")) > 1, "open \"test.txt\"");
+
+  byte_cnt = copy_file_range (in_fd, out_fd, 100);
+  if (byte_cnt != 100)
+    fail ("copy_file_range() returned %d instead of 100", byte_cnt);
+  if (tell (in_fd) != 100 || tell (out_fd) != 100)
+    fail ("positions are %u and %u instead of 100",
+          tell (in_fd), tell (out_fd));
+
+  byte_cnt = copy_file_range (in_fd, out_fd, 4096);
+  if (byte_cnt != (int) size - 100)
+    fail ("copy_file_range() returned %d instead of %zu",
+          byte_cnt, size - 100);
+  CHECK (copy_file_range (in_fd, out_fd, 4096) == 0,
+         "copy_file_range at end of file");
+  CHECK (copy_file_range (in_fd, 1, 1) == -1,
+         "copy_file_range to the console fails");
+
+  seek (out_fd, 0);
+  check_file_handle (out_fd, "test.txt", sample, size);
+}
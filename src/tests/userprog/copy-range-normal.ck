@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(copy-range-normal) begin
+(copy-range-normal) create "test.txt"
+(copy-range-normal) open "sample.txt"
+(copy-range-normal) open "test.txt"
+(copy-range-normal) copy_file_range at end of file
+(copy-range-normal) copy_file_range to the console fails
+(copy-range-normal) verified contents of "test.txt"
+(copy-range-normal) end
+copy-range-normal: exit(0)
+EOF
+pass;
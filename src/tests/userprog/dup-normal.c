@@ -0,0 +1,27 @@
+/* Duplicates a file descriptor with dup(), which must return a
+   new descriptor that shares the original's file position and
+   stays open after the original is closed. */
+
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int fd, dup_fd;
+
+  CHECK ((fd = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK ((dup_fd = dup (fd)) > 1, "dup");
+  if (dup_fd == fd)
+    fail ("dup() returned the descriptor it was given, %d", fd);
+
+  seek (fd, 20);
+  CHECK (tell (dup_fd) == 20, "seek through one, tell through the other");
+  seek (fd, 0);
+
+  msg ("close original");
+  close (fd);
+  check_file_handle (dup_fd, "sample.txt", sample, sizeof sample - 1);
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(dup-normal) begin
+(dup-normal) open "sample.txt"
+(dup-normal) dup
+(dup-normal) seek through one, tell through the other
+(dup-normal) close original
+(dup-normal) verified contents of "sample.txt"
+(dup-normal) end
+dup-normal: exit(0)
+EOF
+pass;
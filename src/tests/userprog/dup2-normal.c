@@ -0,0 +1,27 @@
+/* Makes one open file descriptor name another's file with
+   dup2(), which must close what it named before, then checks
+   that dup2() of a closed descriptor fails. */
+
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int fd1, fd2;
+
+  CHECK ((fd1 = open ("sample.txt")) > 1, "open \"sample.txt\" once");
+  CHECK ((fd2 = open ("sample.txt")) > 1, "open \"sample.txt\" again");
+  CHECK (dup2 (fd1, fd2) == fd2, "dup2 first onto second");
+
+  seek (fd1, 20);
+  CHECK (tell (fd2) == 20, "descriptors share a position");
+  seek (fd2, 0);
+
+  msg ("close first");
+  close (fd1);
+  check_file_handle (fd2, "sample.txt", sample, sizeof sample - 1);
+  CHECK (dup2 (fd1, fd2) == -1, "dup2 of closed descriptor fails");
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(dup2-normal) begin
+(dup2-normal) open "sample.txt" once
+(dup2-normal) open "sample.txt" again
+(dup2-normal) dup2 first onto second
+(dup2-normal) descriptors share a position
+(dup2-normal) close first
+(dup2-normal) verified contents of "sample.txt"
+(dup2-normal) dup2 of closed descriptor fails
+(dup2-normal) end
+dup2-normal: exit(0)
+EOF
+pass;
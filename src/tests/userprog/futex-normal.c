@@ -0,0 +1,19 @@
+/* Checks the cases of futex() that return at once: waiting on a
+   futex that does not hold the expected value, waking a futex
+   with no sleepers, and a misaligned futex. */
+
+#include <futex.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  static int words[2];
+
+  CHECK (futex (&words[0], FUTEX_WAIT, 1) == -1, "wait on a changed value");
+  CHECK (futex (&words[0], FUTEX_WAKE, 1) == 0, "wake with no sleepers");
+  CHECK (futex ((int *) ((char *) words + 1), FUTEX_WAIT, 0) == -1,
+         "wait on a misaligned futex");
+}
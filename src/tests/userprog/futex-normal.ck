@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(futex-normal) begin
+(futex-normal) wait on a changed value
+(futex-normal) wake with no sleepers
+(futex-normal) wait on a misaligned futex
+(futex-normal) end
+futex-normal: exit(0)
+EOF
+pass;
@@ -0,0 +1,46 @@
+/* Checks that monotime() returns a positive number of
+   nanoseconds that never decreases from one call to the next
+   and that moves forward while we spin for a few timer ticks.
+   The kernel returns the 64-bit result in EDX:EAX, so a mangled
+   upper half would show up as a jump backward. */
+
+#include <inttypes.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Number of back-to-back calls to compare. */
+#define CALLS 1000
+
+/* How long to spin: three ticks at the default 100 Hz. */
+#define SPIN_NS (3 * 10 * 1000 * 1000)
+
+/* Returns monotime(), failing the test if it is less than
+   PREV. */
+static int64_t
+next_time (int64_t prev) 
+{
+  int64_t now = monotime ();
+  if (now < prev)
+    fail ("monotime() went back from %"PRId64" to %"PRId64, prev, now);
+  return now;
+}
+
+void
+test_main (void) 
+{
+  int64_t start, now;
+  int i;
+
+  start = monotime ();
+  CHECK (start > 0, "monotime() is positive");
+
+  now = start;
+  for (i = 0; i < CALLS; i++)
+    now = next_time (now);
+  msg ("monotime() never decreased in %d calls", CALLS);
+
+  while (now - start < SPIN_NS)
+    now = next_time (now);
+  msg ("monotime() advanced across a busy loop");
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(monotime-normal) begin
+(monotime-normal) monotime() is positive
+(monotime-normal) monotime() never decreased in 1000 calls
+(monotime-normal) monotime() advanced across a busy loop
+(monotime-normal) end
+monotime-normal: exit(0)
+EOF
+pass;
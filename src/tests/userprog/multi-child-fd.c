@@ -1,6 +1,6 @@
-/* Opens a file and then runs a subprocess that tries to close
-   the file.  (Pintos does not have inheritance of file handles,
-   so this must fail.)  The parent process then attempts to use
+/* Opens a file and then runs a subprocess that closes it.  The
+   subprocess inherits its own copy of the file descriptor, so
+   closing it must succeed without affecting ours: we then use
    the file handle, which must succeed. */
 
 #include <stdio.h>
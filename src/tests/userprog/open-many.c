@@ -0,0 +1,28 @@
+/* Opens "sample.txt" until open() fails, which must happen at
+   the limit of 8192 descriptors per process, and not before.
+   Closing one descriptor must then let open() reuse it. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Descriptors per process, of which 0 and 1 are the console. */
+#define FD_LIMIT 8192
+
+void
+test_main (void) 
+{
+  int fd, cnt = 0;
+
+  msg ("open \"sample.txt\" until open fails");
+  while ((fd = open ("sample.txt")) >= 0)
+    if (++cnt > FD_LIMIT)
+      fail ("opened more than %d files", FD_LIMIT);
+  if (cnt != FD_LIMIT - 2)
+    fail ("open() failed after %d files instead of %d", cnt, FD_LIMIT - 2);
+
+  msg ("close one");
+  close (100);
+  CHECK (open ("sample.txt") == 100, "open reuses it");
+  CHECK (open ("sample.txt") == -1, "open past the limit fails again");
+}
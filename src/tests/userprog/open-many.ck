@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(open-many) begin
+(open-many) open "sample.txt" until open fails
+(open-many) close one
+(open-many) open reuses it
+(open-many) open past the limit fails again
+(open-many) end
+open-many: exit(0)
+EOF
+pass;
@@ -0,0 +1,31 @@
+/* Sends data through a pipe within one process, then checks
+   that the reader sees end of file once the write end is closed
+   and that writing fails once the read end is closed. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  static const char data[] = "through the pipe";
+  char buf[sizeof data];
+  int fds[2];
+
+  CHECK (pipe (fds) == 0, "pipe");
+  CHECK (write (fds[1], data, sizeof data) == sizeof data, "write");
+  CHECK (read (fds[0], buf, sizeof buf) == sizeof buf, "read");
+  if (memcmp (buf, data, sizeof data))
+    fail ("read back \"%s\" instead of \"%s\"", buf, data);
+
+  msg ("close write end");
+  close (fds[1]);
+  CHECK (read (fds[0], buf, sizeof buf) == 0, "read at end of file");
+
+  CHECK (pipe (fds) == 0, "pipe again");
+  msg ("close read end");
+  close (fds[0]);
+  CHECK (write (fds[1], data, sizeof data) == 0, "write with no reader");
+}
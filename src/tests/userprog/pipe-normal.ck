@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pipe-normal) begin
+(pipe-normal) pipe
+(pipe-normal) write
+(pipe-normal) read
+(pipe-normal) close write end
+(pipe-normal) read at end of file
+(pipe-normal) pipe again
+(pipe-normal) close read end
+(pipe-normal) write with no reader
+(pipe-normal) end
+pipe-normal: exit(0)
+EOF
+pass;
@@ -0,0 +1,45 @@
+/* Runs a pipeline as the shell does: one child writes to a pipe
+   without end, on its standard output, and another reads a few
+   bytes from it, on its standard input, and exits.  The pipe's
+   own descriptors are close-on-exec, so the writer holds no read
+   end, and its writes must fail once the reader is gone instead
+   of waiting forever for room. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int fds[2], saved;
+  pid_t writer, reader;
+  int writer_status, reader_status;
+
+  CHECK (pipe (fds) == 0, "pipe");
+  CHECK (set_cloexec (fds[0], true) && set_cloexec (fds[1], true),
+         "set close-on-exec");
+
+  /* No messages while standard output is the pipe. */
+  saved = dup (STDOUT_FILENO);
+  dup2 (fds[1], STDOUT_FILENO);
+  writer = exec ("child-pipe-write");
+  dup2 (saved, STDOUT_FILENO);
+  close (saved);
+  close (fds[1]);
+
+  saved = dup (STDIN_FILENO);
+  dup2 (fds[0], STDIN_FILENO);
+  reader = exec ("child-pipe-read");
+  dup2 (saved, STDIN_FILENO);
+  close (saved);
+  close (fds[0]);
+
+  if (writer == PID_ERROR || reader == PID_ERROR)
+    fail ("exec failed");
+  reader_status = wait (reader);
+  writer_status = wait (writer);
+  msg ("reader exited with %d", reader_status);
+  msg ("writer exited with %d", writer_status);
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pipe-reader-exit) begin
+(pipe-reader-exit) pipe
+(pipe-reader-exit) set close-on-exec
+child-pipe-read: exit(10)
+child-pipe-write: exit(0)
+(pipe-reader-exit) reader exited with 10
+(pipe-reader-exit) writer exited with 0
+(pipe-reader-exit) end
+pipe-reader-exit: exit(0)
+EOF
+pass;
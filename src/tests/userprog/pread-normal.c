@@ -0,0 +1,27 @@
+/* Reads the middle of "sample.txt" with pread(), which must not
+   move the file position that read() uses. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char buf[64];
+  int fd, byte_cnt;
+
+  CHECK ((fd = open ("sample.txt")) > 1, "open \"sample.txt\"");
+
+  byte_cnt = pread (fd, buf, sizeof buf, 100);
+  if (byte_cnt != sizeof buf)
+    fail ("pread() returned %d instead of %zu", byte_cnt, sizeof buf);
+  compare_bytes (buf, sample + 100, sizeof buf, 100, "sample.txt");
+  CHECK (tell (fd) == 0, "position unchanged");
+
+  CHECK (pread (fd, buf, sizeof buf, sizeof sample - 1) == 0,
+         "pread at end of file");
+  check_file_handle (fd, "sample.txt", sample, sizeof sample - 1);
+}
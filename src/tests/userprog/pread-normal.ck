@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pread-normal) begin
+(pread-normal) open "sample.txt"
+(pread-normal) position unchanged
+(pread-normal) pread at end of file
+(pread-normal) verified contents of "sample.txt"
+(pread-normal) end
+pread-normal: exit(0)
+EOF
+pass;
@@ -0,0 +1,33 @@
+/* Writes "test.txt" back to front with pwrite(), which must not
+   move the file position, then checks its contents. */
+
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  size_t size = sizeof sample - 1;
+  size_t ofs = size;
+  int fd;
+
+  CHECK (create ("test.txt", size), "create \"test.txt\"");
+  CHECK ((fd = open ("test.txt")) > 1, "open \"test.txt\"");
+
+  msg ("pwrite backward");
+  while (ofs > 0)
+    {
+      size_t chunk = ofs < 37 ? ofs : 37;
+      int byte_cnt;
+
+      ofs -= chunk;
+      byte_cnt = pwrite (fd, sample + ofs, chunk, ofs);
+      if (byte_cnt != (int) chunk)
+        fail ("pwrite() at %zu returned %d instead of %zu",
+              ofs, byte_cnt, chunk);
+    }
+  CHECK (tell (fd) == 0, "position unchanged");
+  check_file_handle (fd, "test.txt", sample, size);
+}
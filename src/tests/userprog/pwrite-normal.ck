@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pwrite-normal) begin
+(pwrite-normal) create "test.txt"
+(pwrite-normal) open "test.txt"
+(pwrite-normal) pwrite backward
+(pwrite-normal) position unchanged
+(pwrite-normal) verified contents of "test.txt"
+(pwrite-normal) end
+pwrite-normal: exit(0)
+EOF
+pass;
@@ -0,0 +1,29 @@
+/* Reads "sample.txt" with a single readv() into three buffers of
+   different sizes, which must be filled in order. */
+
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  static char buf[sizeof sample - 1];
+  struct iovec iov[3];
+  int fd, byte_cnt;
+
+  iov[0].iov_base = buf;
+  iov[0].iov_len = 1;
+  iov[1].iov_base = buf + 1;
+  iov[1].iov_len = 100;
+  iov[2].iov_base = buf + 101;
+  iov[2].iov_len = sizeof buf - 101;
+
+  CHECK ((fd = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  byte_cnt = readv (fd, iov, 3);
+  if (byte_cnt != sizeof buf)
+    fail ("readv() returned %d instead of %zu", byte_cnt, sizeof buf);
+  compare_bytes (buf, sample, sizeof buf, 0, "sample.txt");
+  CHECK (readv (fd, iov, 3) == 0, "readv at end of file");
+}
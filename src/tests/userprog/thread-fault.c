@@ -0,0 +1,13 @@
+/* Runs a child one of whose threads dereferences NULL while its
+   main thread spins.  The fault must end the whole child, with
+   exit code -1. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  msg ("wait(exec()) = %d", wait (exec ("child-thread-fault")));
+}
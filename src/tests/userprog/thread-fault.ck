@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(thread-fault) begin
+child-thread-fault: exit(-1)
+(thread-fault) wait(exec()) = -1
+(thread-fault) end
+thread-fault: exit(0)
+EOF
+pass;
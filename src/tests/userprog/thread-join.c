@@ -0,0 +1,40 @@
+/* Starts threads in the process and joins them: each sees the
+   process's memory, and thread_join() returns the status a
+   thread exited with, once. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static int slots[2];
+
+static void
+store (void *aux) 
+{
+  int *slot = aux;
+  *slot = slot - slots + 1;
+}
+
+static void
+exit_7 (void *aux UNUSED) 
+{
+  exit (7);
+}
+
+void
+test_main (void) 
+{
+  tid_t a, b, c;
+
+  CHECK ((a = thread_create (store, &slots[0])) != TID_ERROR,
+         "create first thread");
+  CHECK ((b = thread_create (store, &slots[1])) != TID_ERROR,
+         "create second thread");
+  CHECK ((c = thread_create (exit_7, NULL)) != TID_ERROR,
+         "create third thread");
+  CHECK (thread_join (a) == 0, "join first thread");
+  CHECK (thread_join (b) == 0, "join second thread");
+  CHECK (thread_join (c) == 7, "join third thread");
+  CHECK (slots[0] == 1 && slots[1] == 2, "threads stored their values");
+  CHECK (thread_join (a) == -1, "join first thread again");
+}
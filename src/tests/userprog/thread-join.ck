@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(thread-join) begin
+(thread-join) create first thread
+(thread-join) create second thread
+(thread-join) create third thread
+(thread-join) join first thread
+(thread-join) join second thread
+(thread-join) join third thread
+(thread-join) threads stored their values
+(thread-join) join first thread again
+(thread-join) end
+thread-join: exit(0)
+EOF
+pass;
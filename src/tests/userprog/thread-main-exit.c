@@ -0,0 +1,20 @@
+/* Runs a child whose main thread returns while one of its other
+   threads spins and another sleeps on a futex.  The other
+   threads must end with it, so that wait() returns and the
+   child's executable can be written again. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int fd;
+  char c;
+
+  msg ("wait(exec()) = %d", wait (exec ("child-thread-exit")));
+  CHECK ((fd = open ("child-thread-exit")) > 1, "open \"child-thread-exit\"");
+  CHECK (pread (fd, &c, 1, 0) == 1, "read \"child-thread-exit\"");
+  CHECK (pwrite (fd, &c, 1, 0) == 1, "write \"child-thread-exit\"");
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(thread-main-exit) begin
+child-thread-exit: exit(81)
+(thread-main-exit) wait(exec()) = 81
+(thread-main-exit) open "child-thread-exit"
+(thread-main-exit) read "child-thread-exit"
+(thread-main-exit) write "child-thread-exit"
+(thread-main-exit) end
+thread-main-exit: exit(0)
+EOF
+pass;
@@ -0,0 +1,51 @@
+/* Several threads increment a shared counter, reading it and
+   writing it back some time later, under a mutex.  Without
+   mutual exclusion, timer interrupts make some increments get
+   lost. */
+
+#include <mutex.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define THREAD_CNT 4
+#define ITER_CNT 1000
+
+static struct mutex mutex = MUTEX_INITIALIZER;
+static int counter;
+
+static void
+increment (void *aux UNUSED) 
+{
+  int i;
+
+  for (i = 0; i < ITER_CNT; i++)
+    {
+      volatile int j;
+      int old;
+
+      mutex_lock (&mutex);
+      old = counter;
+      for (j = 0; j < 100; j++)
+        continue;
+      counter = old + 1;
+      mutex_unlock (&mutex);
+    }
+}
+
+void
+test_main (void) 
+{
+  tid_t tids[THREAD_CNT];
+  int i;
+
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      tids[i] = thread_create (increment, NULL);
+      if (tids[i] == TID_ERROR)
+        fail ("thread_create failed");
+    }
+  for (i = 0; i < THREAD_CNT; i++)
+    thread_join (tids[i]);
+  msg ("counter = %d", counter);
+}
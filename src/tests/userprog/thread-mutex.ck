@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(thread-mutex) begin
+(thread-mutex) counter = 4000
+(thread-mutex) end
+thread-mutex: exit(0)
+EOF
+pass;
@@ -0,0 +1,34 @@
+/* Runs a child whose main thread returns while another of its
+   threads is blocked reading a pipe whose write end only we
+   hold.  That thread must end with the child, without any data
+   or end of file to wake it, so that wait() returns, and it must
+   drop the read end, so that our writes then fail. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int fds[2], saved;
+  pid_t child;
+
+  CHECK (pipe (fds) == 0, "pipe");
+  CHECK (set_cloexec (fds[0], true) && set_cloexec (fds[1], true),
+         "set close-on-exec");
+
+  saved = dup (STDIN_FILENO);
+  dup2 (fds[0], STDIN_FILENO);
+  child = exec ("child-thread-pipe");
+  dup2 (saved, STDIN_FILENO);
+  close (saved);
+  close (fds[0]);
+
+  if (child == PID_ERROR)
+    fail ("exec failed");
+  msg ("wait(exec()) = %d", wait (child));
+  CHECK (write (fds[1], "x", 1) == 0, "write to pipe without reader");
+  close (fds[1]);
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(thread-pipe-exit) begin
+(thread-pipe-exit) pipe
+(thread-pipe-exit) set close-on-exec
+child-thread-pipe: exit(82)
+(thread-pipe-exit) wait(exec()) = 82
+(thread-pipe-exit) write to pipe without reader
+(thread-pipe-exit) end
+thread-pipe-exit: exit(0)
+EOF
+pass;
@@ -0,0 +1,30 @@
+/* Writes "test.txt" with a single writev() from three buffers,
+   which must land in order, then checks its contents. */
+
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  size_t size = sizeof sample - 1;
+  struct iovec iov[3];
+  int fd, byte_cnt;
+
+  iov[0].iov_base = sample;
+  iov[0].iov_len = 50;
+  iov[1].iov_base = sample + 50;
+  iov[1].iov_len = 0;
+  iov[2].iov_base = sample + 50;
+  iov[2].iov_len = size - 50;
+
+  CHECK (create ("test.txt", size), "create \"test.txt\"");
+  CHECK ((fd = open ("test.txt")) > 1, "open \"test.txt\"");
+  byte_cnt = writev (fd, iov, 3);
+  if (byte_cnt != (int) size)
+    fail ("writev() returned %d instead of %zu", byte_cnt, size);
+  seek (fd, 0);
+  check_file_handle (fd, "test.txt", sample, size);
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(writev-normal) begin
+(writev-normal) create "test.txt"
+(writev-normal) open "test.txt"
+(writev-normal) verified contents of "test.txt"
+(writev-normal) end
+writev-normal: exit(0)
+EOF
+pass;
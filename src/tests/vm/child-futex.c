@@ -0,0 +1,25 @@
+/* Child process of futex-shm.
+   Attaches the shared memory segment whose identifier is its
+   first argument, announces itself in the segment's second word,
+   and sleeps on its first word until that is nonzero, then exits
+   with it. */
+
+#include <futex.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/lib.h"
+
+const char *test_name = "child-futex";
+
+int
+main (int argc UNUSED, char *argv[])
+{
+  volatile int *seg = (int *) 0x20000000;
+
+  if (!shm_attach (atoi (argv[1]), (void *) seg))
+    fail ("shm_attach failed");
+  seg[1] = 1;
+  while (seg[0] == 0)
+    futex ((int *) seg, FUTEX_WAIT, 0);
+  return seg[0];
+}
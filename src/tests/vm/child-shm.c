@@ -0,0 +1,25 @@
+/* Child process of shm-child.
+   Attaches the shared memory segment whose identifier is its
+   first argument, at a different address from its parent's,
+   checks the parent's data and writes a reply. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/shm.h"
+#include "tests/lib.h"
+
+const char *test_name = "child-shm";
+
+int
+main (int argc UNUSED, char *argv[])
+{
+  char *seg = (char *) 0x30000000;
+
+  msg ("begin");
+  CHECK (shm_attach (atoi (argv[1]), seg), "shm_attach");
+  CHECK (!strcmp (seg, SHM_PARENT_TEXT), "parent's data seen");
+  strlcpy (seg + SHM_REPLY_OFS, SHM_CHILD_TEXT, SHM_SIZE - SHM_REPLY_OFS);
+  msg ("end");
+  return 0;
+}
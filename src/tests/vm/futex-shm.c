@@ -0,0 +1,31 @@
+/* Runs child-futex, which sleeps on a futex in a shared memory
+   segment until we store a value there and wake it, then exits
+   with that value.  Processes share a futex through the frame
+   behind it, not its address, which differs between them. */
+
+#include <futex.h>
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  volatile int *seg = (int *) 0x10000000;
+  char child_cmd[64];
+  pid_t child;
+  int id;
+
+  CHECK ((id = shm_create ((void *) seg, 4096)) >= 0, "shm_create");
+
+  snprintf (child_cmd, sizeof child_cmd, "child-futex %d", id);
+  CHECK ((child = exec (child_cmd)) != PID_ERROR, "exec child-futex");
+  while (seg[1] == 0)
+    continue;
+
+  msg ("wake child");
+  seg[0] = 42;
+  futex ((int *) seg, FUTEX_WAKE, 1);
+  CHECK (wait (child) == 42, "child saw the value");
+}
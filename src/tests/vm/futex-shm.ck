@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(futex-shm) begin
+(futex-shm) shm_create
+(futex-shm) exec child-futex
+(futex-shm) wake child
+child-futex: exit(42)
+(futex-shm) child saw the value
+(futex-shm) end
+futex-shm: exit(0)
+EOF
+pass;
@@ -0,0 +1,25 @@
+/* Creates a shared memory segment and runs child-shm, which
+   attaches it, checks what we wrote there, and writes back. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/shm.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  char *seg = (char *) 0x10000000;
+  char child_cmd[64];
+  int id;
+
+  CHECK ((id = shm_create (seg, SHM_SIZE)) >= 0, "shm_create");
+  strlcpy (seg, SHM_PARENT_TEXT, SHM_SIZE);
+
+  snprintf (child_cmd, sizeof child_cmd, "child-shm %d", id);
+  CHECK (wait (exec (child_cmd)) == 0, "run child-shm");
+  CHECK (!strcmp (seg + SHM_REPLY_OFS, SHM_CHILD_TEXT),
+         "child's reply seen");
+}
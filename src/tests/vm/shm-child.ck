@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(shm-child) begin
+(shm-child) shm_create
+(shm-child) run child-shm
+(child-shm) begin
+(child-shm) shm_attach
+(child-shm) parent's data seen
+(child-shm) end
+child-shm: exit(0)
+(shm-child) child's reply seen
+(shm-child) end
+shm-child: exit(0)
+EOF
+pass;
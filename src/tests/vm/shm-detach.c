@@ -0,0 +1,21 @@
+/* Creates a shared memory segment that no other mapping shares,
+   touches every page, and detaches it, which frees it.  The
+   memory must then be inaccessible. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (3 * 4096)
+#define SEG ((char *) 0x10000000)
+
+void
+test_main (void)
+{
+  CHECK (shm_create (SEG, SIZE) >= 0, "shm_create");
+  memset (SEG, 0x5a, SIZE);
+  CHECK (shm_detach (SEG), "shm_detach");
+
+  fail ("detached memory is readable (%d)", *(int *) SEG);
+}
@@ -0,0 +1,32 @@
+/* Creates a shared memory segment, attaches it at a second
+   address in the same process, and checks that data written
+   through one mapping is seen through the other, even after the
+   first is detached. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE 8192
+#define FIRST ((char *) 0x10000000)
+#define SECOND ((char *) 0x20000000)
+
+void
+test_main (void)
+{
+  static const char text[] = "shared between two mappings";
+  int id;
+
+  CHECK ((id = shm_create (FIRST, SIZE)) >= 0, "shm_create");
+  CHECK (FIRST[0] == 0 && FIRST[SIZE - 1] == 0, "segment starts zeroed");
+  CHECK (shm_attach (id, SECOND), "shm_attach");
+
+  strlcpy (FIRST + 5000, text, sizeof text);
+  CHECK (!strcmp (SECOND + 5000, text), "data seen through second mapping");
+
+  CHECK (shm_detach (FIRST), "shm_detach first mapping");
+  CHECK (!strcmp (SECOND + 5000, text), "data survives detach");
+  CHECK (!shm_detach (FIRST), "shm_detach it again fails");
+  CHECK (!shm_attach (id, SECOND + 4096), "shm_attach over a mapping fails");
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(shm-normal) begin
+(shm-normal) shm_create
+(shm-normal) segment starts zeroed
+(shm-normal) shm_attach
+(shm-normal) data seen through second mapping
+(shm-normal) shm_detach first mapping
+(shm-normal) data survives detach
+(shm-normal) shm_detach it again fails
+(shm-normal) shm_attach over a mapping fails
+(shm-normal) end
+shm-normal: exit(0)
+EOF
+pass;
@@ -0,0 +1,11 @@
+#ifndef TESTS_VM_SHM_H
+#define TESTS_VM_SHM_H
+
+/* What shm-child and child-shm pass each other through a shared
+   memory segment. */
+#define SHM_SIZE (3 * 4096)
+#define SHM_PARENT_TEXT "written by the parent"
+#define SHM_CHILD_TEXT "written by the child"
+#define SHM_REPLY_OFS (2 * 4096 + 100)
+
+#endif /* tests/vm/shm.h */
@@ -34,9 +34,14 @@
 #ifdef FILESYS
 #include "devices/block.h"
 #include "devices/ide.h"
+#include "devices/ramdisk.h"
+#include "devices/virtio-blk.h"
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
+#ifdef VM
+#include "vm/shm.h"
+#endif
 
 /* Page directory with kernel mappings only. */
 uint32_t *init_page_dir;
@@ -52,6 +57,9 @@ static const char *scratch_bdev_name;
 #ifdef VM
 static const char *swap_bdev_name;
 #endif
+
+/* -ramdisk: Size of RAM disk to create, in kB, or 0 for none. */
+static size_t ramdisk_kb;
 #endif /* FILESYS */
 
 /* -ul: Maximum number of pages to put into palloc's user pool. */
@@ -114,6 +122,9 @@ main (void)
   exception_init ();
   syscall_init ();
 #endif
+#ifdef VM
+  shm_init ();
+#endif
 
   /* Start thread scheduler and enable interrupts. */
   thread_start ();
@@ -123,6 +134,9 @@ main (void)
 #ifdef FILESYS
   /* Initialize file system. */
   ide_init ();
+  virtio_blk_init ();
+  if (ramdisk_kb > 0)
+    ramdisk_init (ramdisk_kb);
   locate_block_devices ();
   filesys_init (format_filesys);
 #endif
@@ -251,6 +265,13 @@ parse_options (char **argv)
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
 #endif
+      else if (!strcmp (name, "-ramdisk"))
+        {
+          int kb = value != NULL ? atoi (value) : 0;
+          if (kb <= 0)
+            PANIC ("invalid -ramdisk size");
+          ramdisk_kb = kb;
+        }
 #endif
       else if (!strcmp (name, "-rs"))
         random_init (atoi (value));
@@ -315,6 +336,8 @@ run_actions (char **argv)
       {"rm", 2, fsutil_rm},
       {"extract", 1, fsutil_extract},
       {"append", 2, fsutil_append},
+      {"fsck", 1, fsutil_fsck},
+      {"defrag", 1, fsutil_defrag},
 #endif
       {NULL, 0, NULL},
     };
@@ -361,6 +384,8 @@ usage (void)
           "  ls                 List files in the root directory.\n"
           "  cat FILE           Print FILE to the console.\n"
           "  rm FILE            Delete FILE.\n"
+          "  fsck               Check file system, rebuild free map if needed.\n"
+          "  defrag             Compact file data to coalesce free space.\n"
           "Use these actions indirectly via `pintos' -g and -p options:\n"
           "  extract            Untar from scratch device into file system.\n"
           "  append FILE        Append FILE to tar file on scratch device.\n"
@@ -376,6 +401,7 @@ usage (void)
 #ifdef VM
           "  -swap=BDEV         Use BDEV for swap instead of default.\n"
 #endif
+          "  -ramdisk=KB        Create a KB kB RAM disk named rd0.\n"
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
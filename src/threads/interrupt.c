@@ -9,6 +9,10 @@
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "devices/timer.h"
+#ifdef USERPROG
+#include "userprog/gdt.h"
+#include "userprog/process.h"
+#endif
 
 /* Programmable Interrupt Controller (PIC) registers.
    A PC has two PICs, called the master and slave PICs, with the
@@ -385,6 +389,15 @@ intr_handler (struct intr_frame *frame)
 
       if (yield_on_return) 
         thread_yield (); 
+
+#ifdef USERPROG
+      /* Interrupted user code holds no locks, so this is a safe
+         place for its thread to follow its exiting process out.
+         A thread that never makes a system call gets here on
+         its next timer tick. */
+      if (frame->cs == SEL_UCSEG)
+        process_check_exit ();
+#endif
     }
 }
 
@@ -76,6 +76,33 @@ sema_down (struct semaphore *sema)
   intr_set_level (old_level);
 }
 
+/* Like sema_down(), but gives up if thread_kill() kills the
+   current thread before or while it waits.  Returns true if SEMA
+   was decremented, false otherwise. */
+bool
+sema_down_killable (struct semaphore *sema) 
+{
+  enum intr_level old_level;
+
+  ASSERT (sema != NULL);
+  ASSERT (!intr_context ());
+
+  old_level = intr_disable ();
+  while (sema->value == 0) 
+    {
+      list_insert_ordered (&sema->waiters, &thread_current ()->elem,
+                           cmp_priority, NULL);
+      if (!thread_block_killable ())
+        {
+          intr_set_level (old_level);
+          return false;
+        }
+    }
+  sema->value--;
+  intr_set_level (old_level);
+  return true;
+}
+
 /* Down or "P" operation on a semaphore, but only if the
    semaphore is not already 0.  Returns true if the semaphore is
    decremented, false otherwise.
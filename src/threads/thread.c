@@ -22,7 +22,6 @@
    Used to detect stack overflow.  See the big comment at the top
    of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
-#define INIT_FD 10
 
 #define NICE_DEFAULT 0
 #define RECENT_CPU_DEFAULT 0
@@ -190,7 +189,6 @@ thread_create (const char *name, int priority,
   struct switch_threads_frame *sf;
   tid_t tid;
   enum intr_level old_level;
-  int i;
 
   ASSERT (function != NULL);
 
@@ -233,14 +231,10 @@ thread_create (const char *name, int priority,
   sema_init(&t->load_sema, 0);						// Init load_sema to 0
   list_push_back(&t->parent->child_list, &t->child_elem);		// Append to Child List
 
-  t->fd_size = INIT_FD;							// Init the fd's value (0 : stdin, 1 : stdout)
-  t->fdt = (struct file**)malloc(t->fd_size*sizeof(struct file*));	// malloc the Fiel Descriptor Tabele
-  for (i = 0; i<t->fd_size; i++)
-  {
-    t->fdt[i] = NULL;
-  }
-
-  t->running_file = NULL;
+#ifdef USERPROG
+  t->proc = NULL;							// Set by start_process() or process_thread_create()
+  t->stack_slot = 0;
+#endif
   /****************************************************************************************/
 
   /* Add to run queue. */
@@ -294,6 +288,55 @@ thread_unblock (struct thread *t)
   intr_set_level (old_level);
 }
 
+/* Like thread_block(), but for a thread that has put itself on
+   a wait list through its ELEM member, as a semaphore's waiters
+   do: thread_kill() may take it off that list and wake it early.
+   Returns false, without sleeping, if the current thread has
+   already been killed, or once it is killed while it sleeps;
+   returns true if it was woken in the usual way.
+
+   This function must be called with interrupts turned off. */
+bool
+thread_block_killable (void) 
+{
+  struct thread *cur = thread_current ();
+
+  ASSERT (!intr_context ());
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (cur->killed)
+    {
+      list_remove (&cur->elem);
+      return false;
+    }
+  cur->killable = true;
+  thread_block ();
+  cur->killable = false;
+  return !cur->killed;
+}
+
+/* Kills T: from now on, thread_block_killable() fails at once
+   in T, and if T is asleep in it, T is taken off the list it
+   waits on and woken.  T decides for itself what to do about
+   it; a user process's threads exit as they return to user
+   mode.
+
+   This function must be called with interrupts turned off. */
+void
+thread_kill (struct thread *t) 
+{
+  ASSERT (is_thread (t));
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  t->killed = true;
+  if (t->status == THREAD_BLOCKED && t->killable)
+    {
+      list_remove (&t->elem);
+      t->killable = false;
+      thread_unblock (t);
+    }
+}
+
 /* Returns the name of the running thread. */
 const char *
 thread_name (void) 
@@ -339,6 +382,7 @@ thread_exit (void)
 #ifdef USERPROG
   process_exit ();
 #endif
+  console_flush ();
 
   /* Remove thread from all threads list, set our status to dying,
      and schedule another process.  That process will destroy us
@@ -1,6 +1,7 @@
 #ifndef THREADS_THREAD_H
 #define THREADS_THREAD_H
 
+#include <console.h>
 #include <debug.h>
 #include <list.h>
 #include <stdint.h>
@@ -96,11 +97,22 @@ struct thread
     /* Shared between thread.c and synch.c. */
     struct list_elem elem;              /* List element. */
 
+    /* Owned by thread.c. */
+    bool killed;                        /* Set by thread_kill(). */
+    bool killable;                      /* In thread_block_killable(). */
+
 #ifdef USERPROG
     /* Owned by userprog/process.c. */
-    uint32_t *pagedir;                  /* Page directory. */
+    uint32_t *pagedir;                  /* Page directory, shared by the
+                                           threads of a process. */
+    struct process *proc;               /* Process, or null if none. */
+    int stack_slot;                     /* User stack slot in PROC. */
 #endif
 
+    /* Owned by lib/kernel/console.c. */
+    char console_line[CONSOLE_LINE_MAX]; /* Output not yet written. */
+    size_t console_len;                 /* Bytes in console_line. */
+
     /* Owned by thread.c. */
     unsigned magic;                     /* Detects stack overflow. */
 
@@ -114,9 +126,6 @@ struct thread
     struct semaphore exit_sema;				// Exit semaphore
     struct semaphore load_sema;				// Load semaphore
     int exit_status;					// Exit Status when exit() called
-    struct file **fdt;					// File Decriptor Table
-    int fd_size;					// fd value's Maximum that exist int current table
-    struct file *running_file;				// Running File
 
     int64_t wakeup_tick;				// 
 
@@ -128,7 +137,6 @@ struct thread
     int nice;
     int recent_cpu;
 
-    struct hash vm;
     /*************************************************************************************************************/
   };
 
@@ -148,6 +156,8 @@ tid_t thread_create (const char *name, int priority, thread_func *, void *);
 
 void thread_block (void);
 void thread_unblock (struct thread *);
+bool thread_block_killable (void);
+void thread_kill (struct thread *);
 
 struct thread *thread_current (void);
 tid_t thread_tid (void);
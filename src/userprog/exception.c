@@ -2,13 +2,19 @@
 #include <inttypes.h>
 #include <stdio.h>
 #include "userprog/gdt.h"
+#include "userprog/process.h"
+#include "userprog/sysenter.h"
+#include "userprog/uaccess.h"
+#include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "vm/page.h"
 
 /* Number of page faults processed. */
 static long long page_fault_cnt;
 
 static void kill (struct intr_frame *);
+static void debug (struct intr_frame *);
 static void page_fault (struct intr_frame *);
 
 /* Registers handlers for interrupts that can be caused by user
@@ -43,7 +49,7 @@ exception_init (void)
      caused indirectly, e.g. #DE can be caused by dividing by
      0.  */
   intr_register_int (0, 0, INTR_ON, kill, "#DE Divide Error");
-  intr_register_int (1, 0, INTR_ON, kill, "#DB Debug Exception");
+  intr_register_int (1, 0, INTR_ON, debug, "#DB Debug Exception");
   intr_register_int (6, 0, INTR_ON, kill, "#UD Invalid Opcode Exception");
   intr_register_int (7, 0, INTR_ON, kill,
                      "#NM Device Not Available Exception");
@@ -89,6 +95,7 @@ kill (struct intr_frame *f)
       printf ("%s: dying due to interrupt %#04x (%s).\n",
               thread_name (), f->vec_no, intr_name (f->vec_no));
       intr_dump_frame (f);
+      process_terminate (-1);
       thread_exit (); 
 
     case SEL_KCSEG:
@@ -108,6 +115,24 @@ kill (struct intr_frame *f)
     }
 }
 
+/* Debug exception handler.  SYSENTER leaves the caller's trap
+   flag set, so a user program that single-steps into it traps
+   in kernel mode before the first instruction of sysenter_entry,
+   on the small stack that sysenter_init() gave SYSENTER.  We
+   clear the flag and let the entry go on; the program loses its
+   single step.  Any other debug exception is handled like other
+   exceptions. */
+static void
+debug (struct intr_frame *f) 
+{
+  if (f->cs == SEL_KCSEG && f->eip == sysenter_entry)
+    {
+      f->eflags &= ~FLAG_TF;
+      return;
+    }
+  kill (f);
+}
+
 /* Page fault handler.  This is a skeleton that must be filled in
    to implement virtual memory.  Some solutions to project 2 may
    also require modifying this code.
@@ -157,19 +182,32 @@ page_fault (struct intr_frame *f)
 
   /*if (user)
   {*/
-    if (not_present)
+    if (not_present && thread_current()->proc != NULL)
     {
+      struct lock *vm_lock = &thread_current()->proc->vm_lock;	// Other threads of the process may fault too
+
+      lock_acquire(vm_lock);
       vme = find_vme(fault_addr);
     
-      if (vme != NULL)
+      if (vme != NULL && !vme->is_loaded)			// Another thread may have just loaded it
       {
         flag_load = handle_mm_fault(vme);
       }
+      else if (vme != NULL)
+        flag_load = true;
+      lock_release(vm_lock);
     }
 
     if (!flag_load)
     {
-      exit(-1);
+      if (user)
+      {
+        process_terminate(-1);			// A fault in any Thread ends the Process
+        exit(-1);
+      }
+      if (uaccess_fixup(f))			// Fault in a user copy routine: make it fail instead
+        return;
+      kill(f);					// Any other kernel fault is a bug, and may hold locks
     }
   //}
 
@@ -0,0 +1,381 @@
+#include "userprog/fdtable.h"
+#include <debug.h>
+#include <round.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "userprog/pipe.h"
+
+/* File descriptors are allocated lowest-free-first, as POSIX
+   requires, from a two-level bitmap.  Each bit of USED covers one
+   fd, and each bit of FULL covers one 32-bit word of USED, so
+   finding the lowest free fd among FD_MAX of them takes at most
+   FD_MAX / 1024 word scans, each resolved with a single bit-scan
+   instruction, instead of a walk over every slot.  The table
+   doubles when it fills, so a process that opens N files copies
+   the table O(log N) times; it never shrinks, so a descriptor's
+   slot stays put once allocated. */
+
+/* Bits per bitmap word. */
+#define WORD_BITS 32
+
+/* Size of a table when it is first needed, and the largest size
+   to which it may grow.  Both are multiples of WORD_BITS. */
+#define FD_INIT_SIZE 64
+#define FD_MAX 8192
+
+/* What fds 0 and 1 name in a table that has not been allocated
+   yet, and whenever they are closed. */
+static const struct fd_entry console[FD_MIN] =
+  {
+    {FD_KEYBOARD, NULL, NULL, false},
+    {FD_SCREEN, NULL, NULL, false},
+  };
+
+/* Returns the number of words in a bitmap of BITS bits. */
+static inline size_t
+bitmap_words (size_t bits) 
+{
+  return DIV_ROUND_UP (bits, WORD_BITS);
+}
+
+/* Returns the index of the lowest clear bit in WORD, which must
+   not be all 1s. */
+static inline int
+lowest_clear (uint32_t word) 
+{
+  ASSERT (word != UINT32_MAX);
+  return __builtin_ctz (~word);
+}
+
+/* Marks FD in use in T. */
+static void
+mark_used (struct fd_table *t, int fd) 
+{
+  int w = fd / WORD_BITS;
+
+  t->used[w] |= 1u << (fd % WORD_BITS);
+  if (t->used[w] == UINT32_MAX)
+    t->full[w / WORD_BITS] |= 1u << (w % WORD_BITS);
+}
+
+/* Marks FD free in T. */
+static void
+mark_free (struct fd_table *t, int fd) 
+{
+  int w = fd / WORD_BITS;
+
+  t->used[w] &= ~(1u << (fd % WORD_BITS));
+  t->full[w / WORD_BITS] &= ~(1u << (w % WORD_BITS));
+  if (fd < t->next_fd)
+    t->next_fd = fd;
+}
+
+/* Grows T so that it covers at least MIN_SIZE fds.  Returns true
+   if successful, false if MIN_SIZE exceeds FD_MAX or memory is
+   short, in which case T is unchanged. */
+static bool
+grow (struct fd_table *t, int min_size) 
+{
+  int old_size = t->size;
+  int new_size = old_size > 0 ? old_size : FD_INIT_SIZE;
+  struct fd_entry *entries;
+  uint32_t *used, *full;
+  size_t old_words, new_words;
+
+  while (new_size < min_size)
+    new_size *= 2;
+  if (new_size > FD_MAX)
+    return false;
+
+  entries = malloc (new_size * sizeof *entries);
+  used = malloc (bitmap_words (new_size) * sizeof *used);
+  full = malloc (bitmap_words (bitmap_words (new_size)) * sizeof *full);
+  if (entries == NULL || used == NULL || full == NULL)
+    {
+      free (entries);
+      free (used);
+      free (full);
+      return false;
+    }
+
+  old_words = bitmap_words (old_size);
+  new_words = bitmap_words (new_size);
+  memset (entries, 0, new_size * sizeof *entries);
+  memset (used, 0, new_words * sizeof *used);
+  memset (full, 0, bitmap_words (new_words) * sizeof *full);
+  if (old_size > 0)
+    {
+      memcpy (entries, t->entries, old_size * sizeof *entries);
+      memcpy (used, t->used, old_words * sizeof *used);
+      memcpy (full, t->full, bitmap_words (old_words) * sizeof *full);
+    }
+  else
+    {
+      /* Fds 0 and 1 are always in use. */
+      memcpy (entries, console, sizeof console);
+      used[0] = (1u << FD_MIN) - 1;
+    }
+
+  free (t->entries);
+  free (t->used);
+  free (t->full);
+  t->entries = entries;
+  t->used = used;
+  t->full = full;
+  t->size = new_size;
+  return true;
+}
+
+/* Adds a reference to the object that E names. */
+static void
+entry_dup (const struct fd_entry *e) 
+{
+  if (e->kind == FD_FILE)
+    file_dup (e->file);
+  else if (e->kind == FD_PIPE_READ || e->kind == FD_PIPE_WRITE)
+    pipe_dup (e->pipe, e->kind == FD_PIPE_WRITE);
+}
+
+/* Drops a reference to the object that E names. */
+static void
+entry_close (const struct fd_entry *e) 
+{
+  if (e->kind == FD_FILE)
+    file_close (e->file);
+  else if (e->kind == FD_PIPE_READ || e->kind == FD_PIPE_WRITE)
+    pipe_close (e->pipe, e->kind == FD_PIPE_WRITE);
+}
+
+/* Initializes T as a table in which only fds 0 and 1 are in use,
+   naming the console.  Nothing is allocated until the first file
+   is opened, so kernel threads cost nothing. */
+void
+fd_table_init (struct fd_table *t) 
+{
+  t->entries = NULL;
+  t->used = NULL;
+  t->full = NULL;
+  t->size = 0;
+  t->next_fd = FD_MIN;
+}
+
+/* Initializes T as a copy of SRC, in which each fd names the
+   same object as in SRC, as a process run by exec() inherits its
+   parent's descriptors.  Fds marked close-on-exec are left out:
+   free in T, or the console if they are 0 or 1.  Returns true if
+   successful, false if memory is short, in which case T is left
+   initialized but empty. */
+bool
+fd_table_copy (struct fd_table *t, const struct fd_table *src) 
+{
+  int fd;
+
+  fd_table_init (t);
+  if (src->size == 0)
+    return true;
+  if (!grow (t, src->size))
+    return false;
+
+  memcpy (t->entries, src->entries, src->size * sizeof *t->entries);
+  memcpy (t->used, src->used, bitmap_words (src->size) * sizeof *t->used);
+  memcpy (t->full, src->full,
+          bitmap_words (bitmap_words (src->size)) * sizeof *t->full);
+  t->next_fd = src->next_fd;
+  for (fd = 0; fd < t->size; fd++)
+    if (t->entries[fd].kind == FD_FREE || !t->entries[fd].close_on_exec)
+      entry_dup (&t->entries[fd]);
+    else if (fd < FD_MIN)
+      t->entries[fd] = console[fd];
+    else
+      {
+        t->entries[fd].kind = FD_FREE;
+        mark_free (t, fd);
+      }
+  return true;
+}
+
+/* Closes every fd in T and frees its memory. */
+void
+fd_table_destroy (struct fd_table *t) 
+{
+  int fd;
+
+  for (fd = 0; fd < t->size; fd++)
+    entry_close (&t->entries[fd]);
+  free (t->entries);
+  free (t->used);
+  free (t->full);
+  fd_table_init (t);
+}
+
+/* Returns the lowest free fd in T, or -1 if T is full. */
+static int
+find_free (const struct fd_table *t) 
+{
+  size_t words = bitmap_words (t->size);
+  size_t s;
+
+  for (s = t->next_fd / (WORD_BITS * WORD_BITS); s < bitmap_words (words);
+       s++)
+    if (t->full[s] != UINT32_MAX)
+      {
+        size_t w = s * WORD_BITS + lowest_clear (t->full[s]);
+
+        /* Bits past the last word of USED are clear too. */
+        if (w >= words)
+          return -1;
+        return w * WORD_BITS + lowest_clear (t->used[w]);
+      }
+  return -1;
+}
+
+/* Makes the lowest free fd in T name what E names and returns
+   the fd, or returns -1 if T cannot grow to make room.  Does not
+   add a reference to the object. */
+static int
+install (struct fd_table *t, const struct fd_entry *e) 
+{
+  int fd = find_free (t);
+
+  if (fd < 0)
+    {
+      fd = t->size > 0 ? t->size : FD_MIN;
+      if (!grow (t, fd + 1))
+        return -1;
+    }
+
+  t->entries[fd] = *e;
+  mark_used (t, fd);
+  t->next_fd = fd + 1;
+  return fd;
+}
+
+/* Installs FILE in T at the lowest free fd and returns the fd, or
+   returns -1 if T cannot grow to make room.  On failure FILE is
+   left to the caller. */
+int
+fd_alloc (struct fd_table *t, struct file *file) 
+{
+  struct fd_entry e = {FD_FILE, file, NULL, false};
+  return install (t, &e);
+}
+
+/* Installs the read end of PIPE in T at the lowest free fd, or
+   its write end if WRITE_END is true, and returns the fd.
+   Returns -1 if T cannot grow to make room. */
+int
+fd_alloc_pipe (struct fd_table *t, struct pipe *pipe, bool write_end) 
+{
+  struct fd_entry e = {write_end ? FD_PIPE_WRITE : FD_PIPE_READ,
+                       NULL, pipe, false};
+  return install (t, &e);
+}
+
+/* Returns what FD names in T, or a null pointer if it names
+   nothing. */
+const struct fd_entry *
+fd_lookup (const struct fd_table *t, int fd) 
+{
+  if (fd < 0)
+    return NULL;
+  else if (fd < t->size)
+    return t->entries[fd].kind != FD_FREE ? &t->entries[fd] : NULL;
+  else if (t->size == 0 && fd < FD_MIN)
+    return &console[fd];
+  else
+    return NULL;
+}
+
+/* Returns the file that FD names in T, or a null pointer if it
+   names no file. */
+struct file *
+fd_get (const struct fd_table *t, int fd) 
+{
+  const struct fd_entry *e = fd_lookup (t, fd);
+  return e != NULL && e->kind == FD_FILE ? e->file : NULL;
+}
+
+/* Closes FD in T, if it names anything.  Fds 0 and 1 go back to
+   naming the console instead of becoming free. */
+void
+fd_close (struct fd_table *t, int fd) 
+{
+  struct fd_entry e;
+
+  if (fd_lookup (t, fd) == NULL || fd >= t->size)
+    return;
+
+  e = t->entries[fd];
+  if (fd < FD_MIN)
+    t->entries[fd] = console[fd];
+  else
+    {
+      t->entries[fd].kind = FD_FREE;
+      mark_free (t, fd);
+    }
+  entry_close (&e);
+}
+
+/* Makes the lowest free fd in T name the same object as FD, for
+   a file sharing its position, and returns it.  The new fd is
+   not close-on-exec.  Returns -1 if FD names nothing or T is
+   full. */
+int
+fd_dup (struct fd_table *t, int fd) 
+{
+  const struct fd_entry *e = fd_lookup (t, fd);
+  struct fd_entry copy;
+  int new_fd;
+
+  if (e == NULL)
+    return -1;
+  copy = *e;
+  copy.close_on_exec = false;
+  new_fd = install (t, &copy);
+  if (new_fd >= 0)
+    entry_dup (&copy);
+  return new_fd;
+}
+
+/* Makes NEW_FD in T name the same object as OLD_FD, closing
+   whatever NEW_FD named before, and returns NEW_FD, which is not
+   close-on-exec.  Returns -1 if OLD_FD names nothing, or NEW_FD
+   is out of range. */
+int
+fd_dup2 (struct fd_table *t, int old_fd, int new_fd) 
+{
+  const struct fd_entry *e = fd_lookup (t, old_fd);
+  struct fd_entry copy;
+
+  if (e == NULL || new_fd < 0)
+    return -1;
+  if (new_fd == old_fd)
+    return new_fd;
+  copy = *e;
+  copy.close_on_exec = false;
+  if (new_fd >= t->size && !grow (t, new_fd + 1))
+    return -1;
+
+  fd_close (t, new_fd);
+  t->entries[new_fd] = copy;
+  mark_used (t, new_fd);
+  entry_dup (&copy);
+  return new_fd;
+}
+
+/* Marks FD in T to be left out of the table of a process that
+   exec() runs, if CLOSE_ON_EXEC is true, or to be inherited as
+   usual if it is false.  Returns false if FD names nothing or
+   memory is short. */
+bool
+fd_set_cloexec (struct fd_table *t, int fd, bool close_on_exec) 
+{
+  if (fd_lookup (t, fd) == NULL)
+    return false;
+  if (fd >= t->size && !grow (t, fd + 1))
+    return false;
+
+  t->entries[fd].close_on_exec = close_on_exec;
+  return true;
+}
@@ -0,0 +1,59 @@
+#ifndef USERPROG_FDTABLE_H
+#define USERPROG_FDTABLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct file;
+struct pipe;
+
+/* Lowest file descriptor that open() can return.  0 and 1 start
+   out as the console, and always name something. */
+#define FD_MIN 2
+
+/* Kinds of object that a file descriptor can name. */
+enum fd_kind
+  {
+    FD_FREE,                    /* Nothing. */
+    FD_KEYBOARD,                /* Console input. */
+    FD_SCREEN,                  /* Console output. */
+    FD_FILE,                    /* An open file. */
+    FD_PIPE_READ,               /* The read end of a pipe. */
+    FD_PIPE_WRITE               /* The write end of a pipe. */
+  };
+
+/* What one file descriptor names. */
+struct fd_entry
+  {
+    enum fd_kind kind;          /* Kind of object. */
+    struct file *file;          /* File, if FD_FILE. */
+    struct pipe *pipe;          /* Pipe, if FD_PIPE_*. */
+    bool close_on_exec;         /* Left out of a process exec() runs? */
+  };
+
+/* A process's table of open files, indexed by file
+   descriptor. */
+struct fd_table
+  {
+    struct fd_entry *entries;   /* What each fd names. */
+    uint32_t *used;             /* One bit per fd, set if in use. */
+    uint32_t *full;             /* One bit per word of USED, set if
+                                   every fd in the word is in use. */
+    int size;                   /* Number of fds the arrays cover. */
+    int next_fd;                /* No fd below this is free. */
+  };
+
+void fd_table_init (struct fd_table *);
+bool fd_table_copy (struct fd_table *, const struct fd_table *);
+void fd_table_destroy (struct fd_table *);
+
+int fd_alloc (struct fd_table *, struct file *);
+int fd_alloc_pipe (struct fd_table *, struct pipe *, bool write_end);
+const struct fd_entry *fd_lookup (const struct fd_table *, int fd);
+struct file *fd_get (const struct fd_table *, int fd);
+void fd_close (struct fd_table *, int fd);
+int fd_dup (struct fd_table *, int fd);
+int fd_dup2 (struct fd_table *, int old_fd, int new_fd);
+bool fd_set_cloexec (struct fd_table *, int fd, bool close_on_exec);
+
+#endif /* userprog/fdtable.h */
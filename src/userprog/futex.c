@@ -0,0 +1,185 @@
+#include "userprog/futex.h"
+#include <hash.h>
+#include <list.h>
+#include <stdint.h>
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
+#include "userprog/uaccess.h"
+
+/* Fast user-space mutexes.
+
+   A futex is just an aligned int in user memory.  User code
+   changes it with atomic instructions and calls into the kernel
+   only to sleep while it holds some value, or to wake those
+   sleeping on it, so an uncontended lock never makes a system
+   call.
+
+   A sleeper is identified by the kernel virtual address of the
+   futex, that is, by the frame that holds it plus the offset
+   within the page, so a futex in a shared memory segment works
+   across processes and one in private memory only within its
+   own address space.  Sleepers are kept on one of FUTEX_BUCKETS
+   wait queues chosen by hashing that address.  Each queue has a
+   lock, and futex_wait() checks the futex's value and queues
+   itself while holding it, so a futex_wake() that follows a
+   change to the value cannot slip in between and be lost. */
+
+/* Number of wait queues.  Must be a power of 2. */
+#define FUTEX_BUCKETS 64
+
+/* A wait queue. */
+struct futex_bucket
+  {
+    struct lock lock;           /* Protects WAITERS. */
+    struct list waiters;        /* List of struct futex_waiter. */
+  };
+
+static struct futex_bucket buckets[FUTEX_BUCKETS];
+
+/* A thread sleeping in futex_wait(). */
+struct futex_waiter
+  {
+    const void *key;            /* Kernel address of the futex. */
+    const struct process *proc; /* Process of the sleeping thread. */
+    struct semaphore sema;      /* Upped to wake the thread. */
+    struct list_elem elem;      /* Element in bucket's WAITERS. */
+  };
+
+/* Initializes the wait queues. */
+void
+futex_init (void) 
+{
+  size_t i;
+
+  for (i = 0; i < FUTEX_BUCKETS; i++)
+    {
+      lock_init (&buckets[i].lock);
+      list_init (&buckets[i].waiters);
+    }
+}
+
+/* Returns the wait queue for the futex at kernel address KEY. */
+static struct futex_bucket *
+bucket_of (const void *key) 
+{
+  return &buckets[hash_int ((uintptr_t) key) & (FUTEX_BUCKETS - 1)];
+}
+
+/* Returns the kernel address of the futex at user address UADDR
+   in the current process, or a null pointer if UADDR is not
+   mapped. */
+static const void *
+futex_key (const int *uaddr) 
+{
+  return pagedir_get_page (thread_current ()->pagedir, uaddr);
+}
+
+/* If the futex at UADDR holds VAL, sleeps until futex_wake() is
+   called on it, or the process exits, and returns 0.  Otherwise
+   returns -1 at once, as it does if UADDR is misaligned or not
+   readable. */
+int
+futex_wait (int *uaddr, int val) 
+{
+  struct futex_bucket *b;
+  struct futex_waiter w;
+  int cur;
+
+  if ((uintptr_t) uaddr % sizeof *uaddr != 0)
+    return -1;
+
+  /* Reading the futex first faults its page in, if need be, so
+     that it has a key. */
+  if (!copy_from_user (&cur, uaddr, sizeof cur))
+    return -1;
+  w.key = futex_key (uaddr);
+  if (w.key == NULL)
+    return -1;
+  b = bucket_of (w.key);
+
+  /* Checking for an exiting process under the bucket lock means
+     futex_wake_process() cannot miss us. */
+  lock_acquire (&b->lock);
+  if (!copy_from_user (&cur, uaddr, sizeof cur) || cur != val
+      || thread_current ()->proc->exiting)
+    {
+      lock_release (&b->lock);
+      return -1;
+    }
+  w.proc = thread_current ()->proc;
+  sema_init (&w.sema, 0);
+  list_push_back (&b->waiters, &w.elem);
+  lock_release (&b->lock);
+
+  sema_down (&w.sema);
+  return 0;
+}
+
+/* Wakes up to CNT threads sleeping on the futex at UADDR, in the
+   order they went to sleep, and returns the number woken. */
+int
+futex_wake (int *uaddr, int cnt) 
+{
+  struct futex_bucket *b;
+  const void *key;
+  struct list_elem *e;
+  int woken = 0;
+
+  if ((uintptr_t) uaddr % sizeof *uaddr != 0 || !is_user_vaddr (uaddr))
+    return -1;
+
+  /* No one can be sleeping on a futex whose page is not mapped. */
+  key = futex_key (uaddr);
+  if (key == NULL)
+    return 0;
+  b = bucket_of (key);
+
+  lock_acquire (&b->lock);
+  for (e = list_begin (&b->waiters);
+       e != list_end (&b->waiters) && woken < cnt; )
+    {
+      struct futex_waiter *w = list_entry (e, struct futex_waiter, elem);
+      if (w->key == key)
+        {
+          e = list_remove (e);
+          sema_up (&w->sema);
+          woken++;
+        }
+      else
+        e = list_next (e);
+    }
+  lock_release (&b->lock);
+
+  return woken;
+}
+
+/* Wakes every thread of PROC sleeping in futex_wait(), whatever
+   futex it sleeps on, so that it notices that PROC is exiting. */
+void
+futex_wake_process (const struct process *proc) 
+{
+  size_t i;
+
+  for (i = 0; i < FUTEX_BUCKETS; i++)
+    {
+      struct futex_bucket *b = &buckets[i];
+      struct list_elem *e;
+
+      lock_acquire (&b->lock);
+      for (e = list_begin (&b->waiters); e != list_end (&b->waiters); )
+        {
+          struct futex_waiter *w = list_entry (e, struct futex_waiter, elem);
+          if (w->proc == proc)
+            {
+              e = list_remove (e);
+              sema_up (&w->sema);
+            }
+          else
+            e = list_next (e);
+        }
+      lock_release (&b->lock);
+    }
+}
@@ -0,0 +1,11 @@
+#ifndef USERPROG_FUTEX_H
+#define USERPROG_FUTEX_H
+
+struct process;
+
+void futex_init (void);
+int futex_wait (int *uaddr, int val);
+int futex_wake (int *uaddr, int cnt);
+void futex_wake_process (const struct process *);
+
+#endif /* userprog/futex.h */
@@ -0,0 +1,237 @@
+#include "userprog/pipe.h"
+#include <debug.h>
+#include <list.h>
+#include <stdint.h>
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/uaccess.h"
+
+/* A pipe is a one-page ring buffer with a single producer and a
+   single consumer.  HEAD counts the bytes ever written into it
+   and is changed only by the writer; TAIL counts the bytes ever
+   read from it and is changed only by the reader.  Each side
+   moves the data before it publishes its new count, so neither
+   needs a lock to move data.  The ring is empty when HEAD ==
+   TAIL and full when HEAD - TAIL == PIPE_SIZE; since PIPE_SIZE
+   is a power of 2, the counts may wrap freely.
+
+   Several threads may hold the same end of a pipe, through
+   dup() or by inheriting it from the process that ran them, so
+   READ_LOCK and WRITE_LOCK admit only one reader and one writer
+   at a time.  That keeps the ring single-producer,
+   single-consumer.
+
+   A reader that finds the ring empty, or a writer that finds it
+   full, sleeps until the other side moves data or closes its
+   end, or until it is killed (see thread_kill()), as when its
+   process exits.  As in devices/intq.c, the test and the sleep
+   happen with interrupts off, so the wakeup cannot come in
+   between. */
+
+/* Bytes of data a pipe holds. */
+#define PIPE_SIZE PGSIZE
+
+/* A pipe. */
+struct pipe
+  {
+    uint8_t *buf;               /* PIPE_SIZE bytes of data. */
+    size_t head;                /* Bytes written; only the writer changes it. */
+    size_t tail;                /* Bytes read; only the reader changes it. */
+    struct lock read_lock;      /* Held by the one active reader. */
+    struct lock write_lock;     /* Held by the one active writer. */
+    struct list reader;         /* Reader sleeping on an empty ring. */
+    struct list writer;         /* Writer sleeping on a full ring. */
+    int readers;                /* Open read ends. */
+    int writers;                /* Open write ends. */
+  };
+
+/* Creates and returns a new, empty pipe with one read end and
+   one write end open.  Returns a null pointer if memory is
+   short. */
+struct pipe *
+pipe_create (void) 
+{
+  struct pipe *p = malloc (sizeof *p);
+  if (p == NULL)
+    return NULL;
+
+  p->buf = palloc_get_page (0);
+  if (p->buf == NULL)
+    {
+      free (p);
+      return NULL;
+    }
+  p->head = p->tail = 0;
+  lock_init (&p->read_lock);
+  lock_init (&p->write_lock);
+  list_init (&p->reader);
+  list_init (&p->writer);
+  p->readers = p->writers = 1;
+  return p;
+}
+
+/* Opens another read end of P, or another write end if
+   WRITE_END is true. */
+void
+pipe_dup (struct pipe *p, bool write_end) 
+{
+  enum intr_level old_level = intr_disable ();
+  if (write_end)
+    p->writers++;
+  else
+    p->readers++;
+  intr_set_level (old_level);
+}
+
+/* Wakes the thread sleeping on WAITERS, if any.  The read and
+   write locks let at most one thread sleep there. */
+static void
+wake (struct list *waiters) 
+{
+  enum intr_level old_level = intr_disable ();
+  if (!list_empty (waiters))
+    thread_unblock (list_entry (list_pop_front (waiters),
+                                struct thread, elem));
+  intr_set_level (old_level);
+}
+
+/* Puts the current thread to sleep on WAITERS until wake() wakes
+   it.  Returns false if the thread is killed instead.
+   Interrupts must be off. */
+static bool
+sleep_on (struct list *waiters) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  list_push_back (waiters, &thread_current ()->elem);
+  return thread_block_killable ();
+}
+
+/* Closes a read end of P, or a write end if WRITE_END is true.
+   The other side learns of it if it is sleeping: a reader sees
+   end of file once no write end is open, and a writer fails once
+   no read end is.  P is freed when its last end is closed.
+
+   The wakeup happens before interrupts come back on: once they
+   do, the other side may close the last end and free P. */
+void
+pipe_close (struct pipe *p, bool write_end) 
+{
+  enum intr_level old_level;
+  bool last;
+
+  old_level = intr_disable ();
+  if (write_end)
+    p->writers--;
+  else
+    p->readers--;
+  last = p->readers == 0 && p->writers == 0;
+  if (!last)
+    wake (write_end ? &p->reader : &p->writer);
+  intr_set_level (old_level);
+
+  if (last)
+    {
+      palloc_free_page (p->buf);
+      free (p);
+    }
+}
+
+/* Reads up to SIZE bytes from P into user buffer UBUF, waiting
+   until at least one byte is available, unless no write end is
+   open.  Returns the number of bytes read, 0 at end of file, or
+   -1 if UBUF is bad or the calling thread is killed while it
+   waits. */
+int
+pipe_read (struct pipe *p, void *ubuf, size_t size) 
+{
+  enum intr_level old_level;
+  size_t avail, ofs, first, n;
+  bool ok;
+
+  if (size == 0)
+    return 0;
+
+  lock_acquire (&p->read_lock);
+  old_level = intr_disable ();
+  while (p->head == p->tail && p->writers > 0)
+    if (!sleep_on (&p->reader))
+      {
+        intr_set_level (old_level);
+        lock_release (&p->read_lock);
+        return -1;
+      }
+  intr_set_level (old_level);
+
+  /* Read HEAD before the data it covers. */
+  avail = p->head - p->tail;
+  barrier ();
+
+  n = size < avail ? size : avail;
+  ofs = p->tail % PIPE_SIZE;
+  first = n < PIPE_SIZE - ofs ? n : PIPE_SIZE - ofs;
+  ok = (copy_to_user (ubuf, p->buf + ofs, first)
+        && copy_to_user ((uint8_t *) ubuf + first, p->buf, n - first));
+
+  /* Finish with the data before the writer may reuse it. */
+  barrier ();
+  if (ok)
+    p->tail += n;
+  wake (&p->writer);
+  lock_release (&p->read_lock);
+
+  return ok ? (int) n : -1;
+}
+
+/* Writes SIZE bytes from user buffer UBUF into P, waiting for
+   room as needed.  Returns the number of bytes written, which is
+   less than SIZE, perhaps 0, only if every read end is closed or
+   the calling thread is killed while it waits, or -1 if UBUF is
+   bad. */
+int
+pipe_write (struct pipe *p, const void *ubuf, size_t size) 
+{
+  const uint8_t *src = ubuf;
+  enum intr_level old_level;
+  size_t done = 0;
+
+  lock_acquire (&p->write_lock);
+  while (done < size)
+    {
+      size_t room, ofs, first, n;
+
+      old_level = intr_disable ();
+      while (p->head - p->tail == PIPE_SIZE && p->readers > 0)
+        if (!sleep_on (&p->writer))
+          break;
+      intr_set_level (old_level);
+      if (p->readers == 0 || p->head - p->tail == PIPE_SIZE)
+        break;
+
+      /* Read TAIL before reusing the space it frees. */
+      room = PIPE_SIZE - (p->head - p->tail);
+      barrier ();
+
+      n = size - done < room ? size - done : room;
+      ofs = p->head % PIPE_SIZE;
+      first = n < PIPE_SIZE - ofs ? n : PIPE_SIZE - ofs;
+      if (!copy_from_user (p->buf + ofs, src + done, first)
+          || !copy_from_user (p->buf, src + done + first, n - first))
+        {
+          lock_release (&p->write_lock);
+          return -1;
+        }
+
+      /* Publish the data only once it is all in place. */
+      barrier ();
+      p->head += n;
+      done += n;
+      wake (&p->reader);
+    }
+  lock_release (&p->write_lock);
+
+  return done;
+}
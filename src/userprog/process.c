@@ -5,9 +5,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "userprog/futex.h"
 #include "userprog/gdt.h"
 #include "userprog/pagedir.h"
 #include "userprog/tss.h"
+#include "userprog/uaccess.h"
 //#include "userprog/syscall.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
@@ -15,15 +17,19 @@
 #include "threads/flags.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 
 #include "vm/page.h"
+#include "vm/shm.h"
 
 extern struct lock filesys_lock;
+void exit (int status);
 
 static thread_func start_process NO_RETURN;
+static thread_func start_thread NO_RETURN;
 static bool load (const char *cmdline, void (**eip) (void), void **esp);
 
 /********************* VM***************************/
@@ -37,59 +43,27 @@ int process_add_file (struct file *f);
 struct thread *get_child_process (int pid);
 void remove_child_process (struct thread *cp);
 void argument_stack (char **parse, int count, void **esp);
+static int alloc_thread_stack (struct process *proc);
+static void free_thread_stack (struct process *proc, int slot);
+static void kill_sibling (struct thread *, void *proc);
+
+/* Pages of user stack each thread may use.  Slot N of a process's user stacks ends THREAD_STACK_PAGES * N pages
+   below PHYS_BASE; slot 0 is the main thread's, which load() sets up */
+#define THREAD_STACK_PAGES 16
+#define THREAD_STACK_TOP(SLOT) ((uint8_t *) PHYS_BASE - (SLOT) * THREAD_STACK_PAGES * PGSIZE)
 
 /*******************************************************************************************************/
 void process_close_file (int fd)
 {
-	struct file *f;
-
-	f = process_get_file(fd);			// Get File Object as use fd value
-
-	if (!f)						// If kernel get File Object,
-	{
-		file_close(f);				// Close the file
-		thread_current()->fdt[fd] = NULL;	// Init the entry
-	}
+	fd_close(&thread_current()->proc->fds, fd);		// Close the File and Free the fd
 }
 struct file *process_get_file(int fd)
 {
-	struct thread *t;
-
-	t = thread_current();				// Get Current Running Thread Object
-
-	if (fd < 2 || t->fd_size <= fd)			// If fd value is invalid
-	{
-		return NULL;				// Return NULL
-	}
-	return t->fdt[fd];				// If not, Return File Object
+	return fd_get(&thread_current()->proc->fds, fd);	// Return File Object, or NULL if fd is invalid
 }
 int process_add_file (struct file *f)
 {
-	int fd;
-	struct thread *t;
-
-	t = thread_current();				// Get Current Running Thread Object
-
-	for (fd = 2; fd < t->fd_size; fd++)		// Trace the Empty entry for File Object
-	{
-		if (!t->fdt[fd])			// If there is Empty,
-		{
-			t->fdt[fd] = f;			// Insert it
-			return fd;			// and Return fd value
-		}
-	}
-
-	// On the Other hand, there is no empty entry Case
-	t->fdt = realloc(t->fdt, (t->fd_size*2)*sizeof(struct file*));
-	for (fd = t->fd_size; fd<t->fd_size*2; fd++)
-	{
-		t->fdt[fd] = 0;
-	}
-	t->fdt[t->fd_size] = f;
-	fd = t->fd_size;
-	t->fd_size = t->fd_size*2;
-
-	return fd;
+	return fd_alloc(&thread_current()->proc->fds, f);	// Lowest free fd, or -1 if the table can't grow
 }
 struct thread *get_child_process (int pid)
 {
@@ -176,6 +150,63 @@ void argument_stack(char **parse, int count, void **esp)
 
 	palloc_free_page(address);
 }
+/* Reserves a free user stack slot of PROC, the current thread's, and maps its pages as VM_ANON, so that each is only
+   allocated, zeroed, when first touched.  Returns the slot, or -1 if every slot is taken or its pages are in use */
+static int alloc_thread_stack (struct process *proc)
+{
+	struct vm_entry *vme;
+	uint8_t *bottom;
+	int slot, i;
+
+	lock_acquire(&proc->vm_lock);
+
+	for (slot = 1; slot < PROCESS_THREAD_MAX; slot++)	// Lowest Free Slot
+		if ((proc->stack_slots & (1u << slot)) == 0)
+			break;
+	bottom = THREAD_STACK_TOP(slot + 1);
+	for (i = 0; slot < PROCESS_THREAD_MAX && i < THREAD_STACK_PAGES; i++)
+		if (find_vme(bottom + i * PGSIZE) != NULL)	// e.g. a Shared Memory Segment
+			slot = PROCESS_THREAD_MAX;
+	if (slot == PROCESS_THREAD_MAX)
+	{
+		lock_release(&proc->vm_lock);
+		return -1;
+	}
+
+	for (i = 0; i < THREAD_STACK_PAGES; i++)
+	{
+		vme = calloc(1, sizeof *vme);
+		if (vme == NULL)
+		{
+			while (i-- > 0)				// Undo the pages mapped so far
+				vm_remove(find_vme(bottom + i * PGSIZE));
+			lock_release(&proc->vm_lock);
+			return -1;
+		}
+		vme->type = VM_ANON;
+		vme->vaddr = bottom + i * PGSIZE;
+		vme->writable = true;
+		vme->is_loaded = false;
+		insert_vme(&proc->vm, vme);
+	}
+	proc->stack_slots |= 1u << slot;
+
+	lock_release(&proc->vm_lock);
+
+	return slot;
+}
+/* Unmaps user stack SLOT of PROC, the current thread's, freeing the pages it touched, and releases the slot */
+static void free_thread_stack (struct process *proc, int slot)
+{
+	uint8_t *bottom = THREAD_STACK_TOP(slot + 1);
+	int i;
+
+	lock_acquire(&proc->vm_lock);
+	for (i = 0; i < THREAD_STACK_PAGES; i++)
+		vm_remove(find_vme(bottom + i * PGSIZE));
+	proc->stack_slots &= ~(1u << slot);
+	lock_release(&proc->vm_lock);
+}
 /*******************************************************************************************************/
 
 /* Starts a new thread running a user program loaded from
@@ -239,14 +270,36 @@ start_process (void *file_name_)
   }
   /************************************************************************************/
 
-  vm_init(&thread_current()->vm);
+  t->proc = malloc(sizeof *t->proc);
+  t->load_success = t->proc != NULL;
+  if (t->load_success)
+  {
+    t->proc->ref_cnt = 1;
+    t->proc->pid = t->tid;
+    vm_init(&t->proc->vm);
+    lock_init(&t->proc->vm_lock);
+    t->proc->running_file = NULL;
+    t->proc->stack_slots = 1;					// Slot 0 is the Main Thread's, set up by load()
+    t->proc->exiting = false;
+    t->proc->exit_status = 0;
+    sema_init(&t->proc->thread_exited, 0);
+
+    /* Inherit the parent's descriptors, which it can't change while it waits in exec() for us to load */
+    lock_acquire(&filesys_lock);
+    if (t->parent->proc != NULL)
+      t->load_success = fd_table_copy(&t->proc->fds, &t->parent->proc->fds);
+    else
+      fd_table_init(&t->proc->fds);				// Started by the Kernel
+    lock_release(&filesys_lock);
+  }
 
   /* Initialize interrupt frame and load executable. */
   memset (&if_, 0, sizeof if_);
   if_.gs = if_.fs = if_.es = if_.ds = if_.ss = SEL_UDSEG;
   if_.cs = SEL_UCSEG;
   if_.eflags = FLAG_IF | FLAG_MBS;
-  t->load_success = load (file_name, &if_.eip, &if_.esp);
+  if (t->load_success)
+    t->load_success = load (file_name, &if_.eip, &if_.esp);
 
   sema_up(&t->load_sema);
 
@@ -300,14 +353,15 @@ process_wait (tid_t child_tid UNUSED)
   /* Search Process Descriptor of Child */
   t = get_child_process(child_tid);
 
-  /* If Exception is occur, return -1 */
-  if (!t)
+  /* If Exception is occur, return -1 (Threads of our own Process are for thread_join()) */
+  if (!t || (thread_current()->proc != NULL && t->proc == thread_current()->proc))
   {
     return -1;
   }
 
-  /* Wait for Child Process's exit as use exit_sema*/
-  sema_down(&t->exit_sema);
+  /* Wait for Child Process's exit as use exit_sema, unless our own Process exits first */
+  if (!sema_down_killable(&t->exit_sema))
+    return -1;
 
   /* remove Child Process Descriptor */
   exit_status = t->exit_status;
@@ -317,38 +371,249 @@ process_wait (tid_t child_tid UNUSED)
   return exit_status;
 }
 
-/* Free the current process's resources. */
+/* What process_thread_create() passes to start_thread(). */
+struct thread_start
+  {
+    struct process *proc;       /* Process to join. */
+    uint32_t *pagedir;          /* Its page directory. */
+    int stack_slot;             /* User stack slot reserved for us. */
+    void *entry;                /* User code to run. */
+    void *arg[2];               /* Arguments to pass ENTRY. */
+  };
+
+/* Starts a new thread in the current process, running user code
+   at ENTRY on a stack of its own, as if ENTRY had been called
+   with ARG0 and ARG1 and a null return address.  The thread
+   shares the process's memory and file descriptors, and ends
+   when the process does.  Returns the new thread's id, for
+   process_thread_join(), or TID_ERROR if the thread cannot be
+   created, as when the process is exiting. */
+tid_t
+process_thread_create (void *entry, void *arg0, void *arg1) 
+{
+  struct thread *cur = thread_current ();
+  struct thread_start start;
+  struct thread *t;
+  tid_t tid;
+
+  start.proc = cur->proc;
+  start.pagedir = cur->pagedir;
+  start.entry = entry;
+  start.arg[0] = arg0;
+  start.arg[1] = arg1;
+  if (cur->proc->exiting)
+    return TID_ERROR;
+  start.stack_slot = alloc_thread_stack (cur->proc);
+  if (start.stack_slot < 0)
+    return TID_ERROR;
+
+  tid = thread_create (cur->name, cur->priority, start_thread, &start);
+  if (tid == TID_ERROR)
+    {
+      free_thread_stack (cur->proc, start.stack_slot);
+      return TID_ERROR;
+    }
+
+  /* Wait until the new thread no longer needs START.  If it
+     failed, it released its stack slot as it exited, and there
+     is nothing to join. */
+  t = get_child_process (tid);
+  sema_down (&t->load_sema);
+  if (!t->load_success)
+    {
+      sema_down (&t->exit_sema);
+      remove_child_process (t);
+      return TID_ERROR;
+    }
+  return tid;
+}
+
+/* A thread function that joins the process in the struct
+   thread_start that START_ points to and starts running its user
+   code. */
+static void
+start_thread (void *start_)
+{
+  struct thread_start *start = start_;
+  struct thread *t = thread_current ();
+  struct intr_frame if_;
+  enum intr_level old_level;
+  uint32_t frame[3];
+  uint8_t *esp;
+
+  t->proc = start->proc;
+  t->pagedir = start->pagedir;
+  t->stack_slot = start->stack_slot;
+  old_level = intr_disable ();
+  t->proc->ref_cnt++;
+  intr_set_level (old_level);
+  process_activate ();
+
+  /* Null return address, then the arguments.  Writing them
+     faults in the top page of the stack. */
+  frame[0] = 0;
+  frame[1] = (uint32_t) start->arg[0];
+  frame[2] = (uint32_t) start->arg[1];
+  esp = THREAD_STACK_TOP (t->stack_slot) - sizeof frame;
+  t->load_success = copy_to_user (esp, frame, sizeof frame);
+
+  memset (&if_, 0, sizeof if_);
+  if_.gs = if_.fs = if_.es = if_.ds = if_.ss = SEL_UDSEG;
+  if_.cs = SEL_UCSEG;
+  if_.eflags = FLAG_IF | FLAG_MBS;
+  if_.eip = (void (*) (void)) start->entry;
+  if_.esp = esp;
+
+  /* START belongs to our creator, which may return as soon as
+     we tell it how we did. */
+  sema_up (&t->load_sema);
+  if (!t->load_success)
+    thread_exit ();
+
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+}
+
+/* Waits for thread TID, which must have been created by the
+   current thread with process_thread_create(), to exit, and
+   returns its exit status.  Returns -1 immediately if TID is not
+   such a thread or has already been joined, and -1 without
+   joining if the process exits meanwhile. */
+int
+process_thread_join (tid_t tid) 
+{
+  struct thread *cur = thread_current ();
+  struct thread *t = get_child_process (tid);
+  int exit_status;
+
+  if (t == NULL || cur->proc == NULL || t->proc != cur->proc)
+    return -1;
+
+  if (!sema_down_killable (&t->exit_sema))
+    return -1;
+  exit_status = t->exit_status;
+  remove_child_process (t);
+  return exit_status;
+}
+
+/* Makes the current process exit with STATUS, unless it is
+   already exiting.  The calling thread carries on until it exits
+   by itself.  Every other thread exits, with STATUS, the next
+   time it returns to user mode.  One asleep in futex_wait() is
+   woken to do so, and so is one in a killable sleep (see
+   thread_kill()), as on a pipe, the keyboard, wait() or
+   thread_join().  A wait for a lock is not cut short. */
+void
+process_terminate (int status) 
+{
+  struct process *proc = thread_current ()->proc;
+  enum intr_level old_level;
+  bool first;
+
+  if (proc == NULL)
+    return;
+
+  old_level = intr_disable ();
+  first = !proc->exiting;
+  if (first)
+    {
+      proc->exiting = true;
+      proc->exit_status = status;
+    }
+  intr_set_level (old_level);
+
+  if (first)
+    {
+      futex_wake_process (proc);
+      old_level = intr_disable ();
+      thread_foreach (kill_sibling, proc);
+      intr_set_level (old_level);
+    }
+}
+
+/* Kills thread T if it belongs to process PROC_ and is not the
+   running thread. */
+static void
+kill_sibling (struct thread *t, void *proc_) 
+{
+  if (t->proc == proc_ && t != thread_current ())
+    thread_kill (t);
+}
+
+/* Makes the current thread exit, with its process's status, if
+   its process is exiting.  Called on the way back to user mode,
+   where the thread holds no locks. */
+void
+process_check_exit (void) 
+{
+  struct process *proc = thread_current ()->proc;
+
+  if (proc != NULL && proc->exiting)
+    {
+      intr_enable ();
+      exit (proc->exit_status);
+    }
+}
+
+/* Free the current process's resources, once its last thread
+   exits.  That is always the main thread, which takes the other
+   threads with it. */
 void
 process_exit (void)
 {
   struct thread *cur = thread_current ();
+  struct process *proc = cur->proc;
+  enum intr_level old_level;
+  bool last = true;
   uint32_t *pd;
-  int i;
 
   /*************************************************/
-  for (i = 0; i<cur->fd_size; i++)
+  if (proc != NULL)
   {
-    if (cur->fdt[i])
+    if (cur->tid == proc->pid)					// Main Thread: wait for the others to follow
+    {
+      process_terminate(cur->exit_status);
+      cur->exit_status = proc->exit_status;			// What wait() returns, also after kill()
+
+      lock_acquire(&filesys_lock);				// Closing our Pipes wakes Threads reading them
+      fd_table_destroy(&proc->fds);
+      lock_release(&filesys_lock);
+
+      old_level = intr_disable();
+      while (proc->ref_cnt > 1)
+        sema_down(&proc->thread_exited);
+      intr_set_level(old_level);
+    }
+
+    if (cur->stack_slot != 0)
+      free_thread_stack(proc, cur->stack_slot);
+
+    old_level = intr_disable();
+    last = --proc->ref_cnt == 0;				// Other Threads still use the Process
+    if (!last)
+      sema_up(&proc->thread_exited);
+    intr_set_level(old_level);
+
+    if (last)
     {
-      file_close(cur->fdt[i]);
+      lock_acquire(&filesys_lock);			// Files may be shared with other processes
+      fd_table_destroy(&proc->fds);
+      lock_release(&filesys_lock);
+
+      vm_destroy(&proc->vm);
+
+      if (proc->running_file)
+        file_close(proc->running_file);		// Close the Running File
+      free(proc);
     }
   }
-  free(cur->fdt);
   /*************************************************/
 
-  vm_destroy(&cur->vm);
-
-  /* Destroy the current process's page directory and switch back
-     to the kernel-only page directory. */
+  /* Destroy the current process's page directory, if no other
+     thread runs on it, and switch back to the kernel-only page
+     directory. */
   pd = cur->pagedir;
 
-  /************************************************************************************************/
-  if (cur->running_file)
-  {
-    file_close(cur->running_file);					// Close the Running File
-  }
-  /************************************************************************************************/
-
   if (pd != NULL) 
     {
       /* Correct ordering here is crucial.  We must set
@@ -360,7 +625,8 @@ process_exit (void)
          that's been freed (and cleared). */
       cur->pagedir = NULL;
       pagedir_activate (NULL);
-      pagedir_destroy (pd);
+      if (last)
+        pagedir_destroy (pd);
     }
 }
 
@@ -479,7 +745,7 @@ load (const char *file_name, void (**eip) (void), void **esp)
       goto done; 
     }
 
-  t->running_file = file;					// Init Running File
+  t->proc->running_file = file;				// Init Running File
   file_deny_write(file);					// Deny write to file
 
   /* Read and verify executable header. */
@@ -680,7 +946,7 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
       vme->read_bytes = page_read_bytes;
       vme->zero_bytes = page_zero_bytes;
 
-      insert_vme(&thread_current()->vm, vme);
+      insert_vme(&thread_current()->proc->vm, vme);
 
       /* Advance. */
       read_bytes -= page_read_bytes;
@@ -721,7 +987,7 @@ setup_stack (void **esp)
   vme->read_bytes = 0;
   vme->zero_bytes = 0;
 
-  insert_vme(&thread_current()->vm, vme);
+  insert_vme(&thread_current()->proc->vm, vme);
 
   return success;
 }
@@ -750,7 +1016,12 @@ bool handle_mm_fault (struct vm_entry *vme)
 	bool flag_load;
 	void *kaddr;
 
+	if (vme->type == VM_SHM)
+		return shm_fault(vme);			// Shared frame, allocated once for every process
+
 	kaddr = palloc_get_page(PAL_USER);
+	if (kaddr == NULL)
+		return false;
 
 	switch (vme->type)
 	{
@@ -761,7 +1032,8 @@ bool handle_mm_fault (struct vm_entry *vme)
 		flag_load = load_file(kaddr, vme);
 		break;
 	case VM_ANON:
-		flag_load = load_file(kaddr, vme);
+		memset(kaddr, 0, PGSIZE);		// Anonymous Memory starts out zeroed
+		flag_load = true;
 		break;
 	default:
 		return false;
@@ -784,9 +1056,9 @@ bool handle_mm_fault (struct vm_entry *vme)
 }
 bool load_file (void *kaddr, struct vm_entry *vme)
 {
-	file_seek(vme->file, vme->offset);
-
-	if (file_read(vme->file, kaddr, vme->read_bytes) != (int)vme->read_bytes)
+	/* KADDR is a whole page, so the file data can be read into it
+	   sector by sector with no bounce buffer. */
+	if (file_read_pages(vme->file, kaddr, vme->read_bytes, vme->offset) != (int)vme->read_bytes)
 	{
 		palloc_free_page(kaddr);
 		return false;
@@ -1,11 +1,46 @@
 #ifndef USERPROG_PROCESS_H
 #define USERPROG_PROCESS_H
 
+#include <hash.h>
+#include "threads/synch.h"
 #include "threads/thread.h"
+#include "userprog/fdtable.h"
+
+/* Most user threads a process may have, counting its main
+   thread. */
+#define PROCESS_THREAD_MAX 32
+
+/* What the threads of one user process share.  Each thread holds
+   a reference, and the last one to exit frees it, along with the
+   page directory they all run on.
+
+   The process ends, taking every thread with it, when its main
+   thread exits or any thread is killed by an exception; see
+   process_terminate().  The main thread exits last, so a parent's
+   wait() returns only once the whole process is gone. */
+struct process
+  {
+    int ref_cnt;                /* Threads using it. */
+    tid_t pid;                  /* Tid of the main thread. */
+    struct hash vm;             /* Virtual memory entries. */
+    struct lock vm_lock;        /* Protects VM once there are threads. */
+    struct fd_table fds;        /* Open file descriptors. */
+    struct file *running_file;  /* Executable, denied writes. */
+    uint32_t stack_slots;       /* Bit N set if user stack N is in use. */
+    bool exiting;               /* Every thread is to exit. */
+    int exit_status;            /* Status to exit with, once EXITING. */
+    struct semaphore thread_exited; /* Upped as each thread but the
+                                       last exits. */
+  };
 
 tid_t process_execute (const char *file_name);
 int process_wait (tid_t);
 void process_exit (void);
 void process_activate (void);
+void process_terminate (int status);
+void process_check_exit (void);
+
+tid_t process_thread_create (void *entry, void *arg0, void *arg1);
+int process_thread_join (tid_t);
 
 #endif /* userprog/process.h */
@@ -1,18 +1,27 @@
 #include "userprog/syscall.h"
+#include <futex.h>
+#include <iovec.h>
 #include <stdio.h>
+#include <string.h>
 #include <syscall-nr.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 
 #include "threads/vaddr.h"
+#include "devices/input.h"
+#include "devices/timer.h"
+#include "filesys/file.h"
+#include "threads/palloc.h"
+#include "userprog/sysenter.h"
+#include "userprog/futex.h"
+#include "userprog/pipe.h"
+#include "userprog/process.h"
+#include "userprog/uaccess.h"
 
 #include "vm/page.h"
-
-#define MAX_SYSTEMCALL_ARGUMENT 10
+#include "vm/shm.h"
 
 static void syscall_handler (struct intr_frame *);
-struct vm_entry *check_address (void *addr, void* esp);
-void get_argument (void *esp, int *arg, int count);
 
 /********************************** System Call's Prototype *****************************************/
 void halt (void);
@@ -28,6 +37,22 @@ int write (int fd, void *buffer, unsigned size);
 void seek (int fd, unsigned position);
 unsigned tell (int fd);
 void close (int fd);
+int64_t monotime (void);
+int dup (int fd);
+int dup2 (int old_fd, int new_fd);
+int pread (int fd, void *buffer, unsigned size, unsigned offset);
+int pwrite (int fd, void *buffer, unsigned size, unsigned offset);
+int readv (int fd, const struct iovec *iov, int iovcnt);
+int writev (int fd, const struct iovec *iov, int iovcnt);
+int copy_file_range (int in_fd, int out_fd, unsigned size);
+int pipe (int *fds);
+bool set_cloexec (int fd, bool close_on_exec);
+int shm_create_call (void *addr, unsigned size);
+bool shm_attach_call (int id, void *addr);
+bool shm_detach_call (void *addr);
+int futex (int *uaddr, int op, int val);
+tid_t thread_create_call (void *entry, void *arg0, void *arg1);
+int thread_join_call (tid_t tid);
 /****************************************************************************************************/
 
 /**********************************************************************************/
@@ -41,9 +66,19 @@ void exit (int status)
 
 	cur = thread_current();					// Get Running Thread
 
+	if (cur->proc != NULL && cur->tid == cur->proc->pid)	// The Main Thread's exit ends the whole Process
+	{
+		process_terminate(status);
+		status = cur->proc->exit_status;		// Unless another Thread's fault ended it first
+	}
+
 	cur->exit_status = status;				// Save Exit Status
 
-	printf("%s: exit(%d)\n", cur->name, status);		// Output Exit Message
+	ASSERT(!lock_held_by_current_thread(&filesys_lock));	// Nor is anything else we hold while moving data
+	ASSERT(cur->proc == NULL || !lock_held_by_current_thread(&cur->proc->vm_lock));
+
+	if (cur->proc == NULL || cur->tid == cur->proc->pid)	// Only the Main Thread speaks for the Process
+		printf("%s: exit(%d)\n", cur->name, status);	// Output Exit Message
 
 	thread_exit();						// Exit Thread
 }
@@ -98,6 +133,8 @@ int open (const char *file)
 	}
 
 	fd = process_add_file(f);			// Give File Descriptor to File Object
+	if (fd < 0)
+		file_close(f);				// Table is Full: don't leak the File
 
 	lock_release(&filesys_lock);			// Unlock
 
@@ -124,76 +161,353 @@ int filesize (int fd)
 
 	return length;					// Return Length of File
 }
-int read (int fd, void *buffer, unsigned size)
+/* Finds what fd names for reading, or for writing if WRITE: a File in *F, the console (*F and *P both NULL), or a Pipe in *P.
+   A File or Pipe comes with a reference of its own, so another Thread's close() or dup2() can't free it under the transfer;
+   release_io() drops it.  Returns false, with no reference taken, if fd names nothing that can be read (written) */
+static bool lookup_io (int fd, bool write, struct file **f, struct pipe **p)
 {
-	struct file *f = process_get_file(fd);
-	char ch, *buffer_ = (char*)buffer;
-	int i = 0;
+	const struct fd_entry *e;
+	bool ok;
 
-	lock_acquire(&filesys_lock);			// Lock
+	*f = NULL;
+	*p = NULL;
 
-	f = process_get_file(fd);			// Search the File Object as use fd
+	lock_acquire(&filesys_lock);			// Lock
 
-	if (fd == 0)					// If fd == 0, Save Keyboard's Input to buffer and return the size that saved to buffer
+	e = fd_lookup(&thread_current()->proc->fds, fd);	// Search what fd names
+	if (e == NULL)
+		ok = false;
+	else if (e->kind == FD_KEYBOARD || e->kind == FD_SCREEN)
+		ok = write == (e->kind == FD_SCREEN);
+	else if (e->kind == FD_PIPE_READ || e->kind == FD_PIPE_WRITE)
 	{
-		for (ch = input_getc(); ch != NULL; ch = input_getc())
+		ok = write == (e->kind == FD_PIPE_WRITE);
+		if (ok)
 		{
-			buffer_[i++] = ch;
+			*p = e->pipe;
+			pipe_dup(*p, write);
 		}
+	}
+	else
+	{
+		*f = file_dup(e->file);
+		ok = true;
+	}
 
-		lock_release(&filesys_lock);
+	lock_release(&filesys_lock);			// Unlock
 
-		return i;
+	return ok;
+}
+/* Drops the reference lookup_io() took to F or P */
+static void release_io (struct file *f, struct pipe *p, bool write)
+{
+	if (f != NULL)
+	{
+		lock_acquire(&filesys_lock);		// Files may be shared with other processes
+		file_close(f);
+		lock_release(&filesys_lock);
 	}
-	else						// If fd != 0, Return the Bytes after Save Data of File.
+	else if (p != NULL)
+		pipe_close(p, write);
+}
+/* Moves SIZE bytes between user buffer UBUF and pipe P, directly, since no lock but P's own is held while doing it.
+   Returns the bytes moved, which are fewer than SIZE when the pipe runs dry or its readers are gone, or -1 for a bad buffer */
+static int transfer_pipe (struct pipe *p, void *ubuf, unsigned size, bool write)
+{
+	return write ? pipe_write(p, ubuf, size) : pipe_read(p, ubuf, size);
+}
+#define BOUNCE_SIZE 256					// Bytes of stack for data that can't move directly
+
+/* Brings every page of the SIZE bytes at user address UBUF into memory, then checks under the process's vm_lock that
+   they are all still mapped, and writable if WRITABLE.  Returns true with vm_lock still held, so that no other thread
+   can unmap the pages while the kernel moves data straight to or from them, even under filesys_lock.  Returns false,
+   without the lock, if UBUF is bad or some page went away, for the caller to fall back on a bounce buffer */
+static bool pin_user_range (const uint8_t *ubuf, unsigned size, bool writable)
+{
+	struct lock *vm_lock = &thread_current()->proc->vm_lock;
+	const uint8_t *page, *end = ubuf + size;
+	struct vm_entry *vme;
+	uint8_t byte;
+
+	if (!is_user_vaddr(ubuf) || size > (uintptr_t) PHYS_BASE - (uintptr_t) ubuf)
+		return false;
+
+	for (page = pg_round_down(ubuf); page < end; page += PGSIZE)	// Fault them in with no lock held
+		if (!copy_from_user(&byte, page < ubuf ? ubuf : page, 1))
+			return false;
+
+	lock_acquire(vm_lock);
+	for (page = pg_round_down(ubuf); page < end; page += PGSIZE)
 	{
-		if (!f)
+		vme = find_vme((void *) page);
+		if (vme == NULL || !vme->is_loaded || (writable && !vme->writable))
 		{
-			lock_release(&filesys_lock);
+			lock_release(vm_lock);
+			return false;
+		}
+	}
+	return true;
+}
+/* Moves SIZE bytes between BUF, which must not fault, and file F, or the screen if F is NULL.  WRITE selects the
+   direction.  File I/O happens at *OFS, which is advanced, if OFS is not NULL, otherwise at F's position.
+   Returns the bytes moved, which are fewer than SIZE at end of file */
+static int move_data (struct file *f, uint8_t *buf, unsigned size, bool write, off_t *ofs)
+{
+	int n;
+
+	if (f == NULL)					// Output to the Console, which needs no lock
+	{
+		putbuf((const char *) buf, size);
+		return size;
+	}
+
+	lock_acquire(&filesys_lock);
+	if (ofs != NULL)
+	{
+		n = write ? file_write_at(f, buf, size, *ofs) : file_read_at(f, buf, size, *ofs);
+		*ofs += n;
+	}
+	else
+		n = write ? file_write(f, buf, size) : file_read(f, buf, size);
+	lock_release(&filesys_lock);
+	return n;
+}
+/* Moves SIZE bytes between user buffer UBUF and file F, or the console if F is NULL (keyboard for reads, screen for writes).
+   WRITE selects the direction, and OFS is as for move_data().  The data goes straight to or from UBUF once its pages are
+   pinned.  Only if that fails, as for a bad buffer, does it pass through a bounce buffer, a piece at a time, so that the
+   copy fails instead of faulting under filesys_lock.  Keyboard input always takes that path, since it may wait forever,
+   and stops short if the thread is killed meanwhile.
+   Returns the bytes moved, which are fewer than SIZE at end of file, or -1 for a bad buffer */
+static int transfer (struct file *f, uint8_t *ubuf, unsigned size, bool write, off_t *ofs)
+{
+	uint8_t bounce[BOUNCE_SIZE];
+	unsigned done = 0, chunk;
+	int n;
+
+	if (size == 0)
+		return 0;
+	if ((f != NULL || write) && pin_user_range(ubuf, size, !write))
+	{
+		n = move_data(f, ubuf, size, write, ofs);
+		lock_release(&thread_current()->proc->vm_lock);
+		return n;
+	}
+
+	while (done < size)
+	{
+		chunk = size - done < sizeof bounce ? size - done : sizeof bounce;
+
+		if (write && !copy_from_user(bounce, ubuf + done, chunk))
+			return -1;
+		if (f == NULL && !write)		// Read Keyboard's Input
+			n = input_read(bounce, chunk);
+		else
+			n = move_data(f, bounce, chunk, write, ofs);
+		if (!write && !copy_to_user(ubuf + done, bounce, n))
 			return -1;
+
+		done += n;
+		if (n < (int) chunk && (f != NULL || n == 0))	// End of File, File can't Grow, or we were killed
+			break;
+	}
+	return done;
+}
+/* Carries out read() or write() (WRITE), or pread() or pwrite() if OFS is not NULL.  A bad buffer kills the process */
+static int transfer_fd (int fd, void *buffer, unsigned size, bool write, off_t *ofs)
+{
+	struct file *f;
+	struct pipe *p;
+	bool bad = false;
+	int n;
+
+	if (!lookup_io(fd, write, &f, &p))
+		return -1;
+
+	if (ofs != NULL && f == NULL)			// Positional I/O needs a real File
+		n = -1;
+	else
+	{
+		n = p != NULL ? transfer_pipe(p, buffer, size, write) : transfer(f, buffer, size, write, ofs);
+		bad = n < 0;
+	}
+
+	release_io(f, p, write);			// Only now, with nothing held, may we die
+	if (bad)
+		exit(-1);
+	return n;
+}
+/* Carries out readv() or writev() (WRITE): one lookup for all IOVCNT buffers.  A bad buffer or vector kills the process */
+static int transfer_vector (int fd, const struct iovec *iov, int iovcnt, bool write)
+{
+	struct file *f;
+	struct pipe *p;
+	struct iovec v;
+	int i, n, total = 0;
+	bool bad = false;
+
+	if (iovcnt < 0 || !lookup_io(fd, write, &f, &p))
+		return -1;
+
+	for (i = 0; i < iovcnt; i++)
+	{
+		if (!copy_from_user(&v, iov + i, sizeof v))
+		{
+			bad = true;
+			break;
 		}
+		if (p != NULL)
+			n = transfer_pipe(p, v.iov_base, v.iov_len, write);
 		else
+			n = transfer(f, v.iov_base, v.iov_len, write, NULL);
+		if (n < 0)
 		{
-			i = file_read(f, buffer, size);
-			
-			lock_release(&filesys_lock);
-
-			return i;
+			bad = true;
+			break;
 		}
+		total += n;
+		if ((size_t) n < v.iov_len)		// Short Transfer ends the whole call
+			break;
 	}
+
+	release_io(f, p, write);
+	if (bad)
+		exit(-1);
+	return total;
+}
+int read (int fd, void *buffer, unsigned size)
+{
+	return transfer_fd(fd, buffer, size, false, NULL);
 }
 int write (int fd, void *buffer, unsigned size)
 {
-	struct file *f;
-	int i;
+	return transfer_fd(fd, buffer, size, true, NULL);
+}
+int pread (int fd, void *buffer, unsigned size, unsigned offset)
+{
+	off_t ofs = offset;
+
+	if (ofs < 0)					// Past the largest File
+		return -1;
+	return transfer_fd(fd, buffer, size, false, &ofs);	// File's position doesn't move
+}
+int pwrite (int fd, void *buffer, unsigned size, unsigned offset)
+{
+	off_t ofs = offset;
+
+	if (ofs < 0)
+		return -1;
+	return transfer_fd(fd, buffer, size, true, &ofs);
+}
+int readv (int fd, const struct iovec *iov, int iovcnt)
+{
+	return transfer_vector(fd, iov, iovcnt, false);
+}
+int writev (int fd, const struct iovec *iov, int iovcnt)
+{
+	return transfer_vector(fd, iov, iovcnt, true);
+}
+/* Copies from in_fd's position to out_fd's, advancing both, without the data passing through user memory */
+int copy_file_range (int in_fd, int out_fd, unsigned size)
+{
+	struct file *in, *out;
+	off_t in_pos, out_pos;
+	int n;
 
 	lock_acquire(&filesys_lock);			// Lock
-	
-	f = process_get_file(fd);			// Search the File Object as use fd
 
-	if (fd == 1)					// If fd == 1, Output the data that saved in buffer, and return size of buffer
+	in = process_get_file(in_fd);
+	out = process_get_file(out_fd);
+	if (!in || !out || (off_t) size < 0)
 	{
-		putbuf(buffer, size);
 		lock_release(&filesys_lock);
-		return size;
+		return -1;
 	}
-	else						// If fd != 1, Record the data that saved in buffer, and return size that recorded
+
+	in_pos = file_tell(in);
+	out_pos = file_tell(out);
+	if (file_get_inode(in) == file_get_inode(out)	// Overlapping Ranges of one File
+	    && in_pos < out_pos + (off_t) size && out_pos < in_pos + (off_t) size)
 	{
-		if (!f)
-		{
-			lock_release(&filesys_lock);
-			return -1;
-		}
+		lock_release(&filesys_lock);
+		return -1;
+	}
+
+	n = file_copy(out, in, size);			// -1 if the Kernel is out of Memory
+
+	lock_release(&filesys_lock);			// Unlock
+
+	return n;					// Return the Bytes Copied
+}
+/* Creates a Pipe and stores the fds of its read and write ends in fds[0] and fds[1] */
+int pipe (int *fds)
+{
+	struct fd_table *t = &thread_current()->proc->fds;
+	struct pipe *p;
+	int kfds[2];
+
+	p = pipe_create();
+	if (p == NULL)
+		return -1;
+
+	lock_acquire(&filesys_lock);			// Lock
+
+	kfds[0] = fd_alloc_pipe(t, p, false);
+	kfds[1] = kfds[0] >= 0 ? fd_alloc_pipe(t, p, true) : -1;
+	if (kfds[1] < 0)				// Table is Full
+	{
+		if (kfds[0] >= 0)
+			fd_close(t, kfds[0]);
 		else
-		{
-			i = file_write(f, buffer, size);
-			
-			lock_release(&filesys_lock);
+			pipe_close(p, false);
+		pipe_close(p, true);
+		lock_release(&filesys_lock);
+		return -1;
+	}
 
-			return i;
-		}
+	lock_release(&filesys_lock);			// Unlock
+
+	if (!copy_to_user(fds, kfds, sizeof kfds))
+		exit(-1);				// exit() closes the new fds
+	return 0;
+}
+/* Creates a Shared Memory Segment of size Bytes, attaches it at addr and returns its id, or -1 */
+int shm_create_call (void *addr, unsigned size)
+{
+	return shm_create(addr, size);
+}
+/* Attaches the Shared Memory Segment id at addr */
+bool shm_attach_call (int id, void *addr)
+{
+	return shm_attach(id, addr);
+}
+/* Detaches the Shared Memory Segment attached at addr; its Memory lives on while others have it attached */
+bool shm_detach_call (void *addr)
+{
+	return shm_detach(addr);
+}
+/* Sleeps while *uaddr == val (FUTEX_WAIT), or wakes up to val Threads sleeping on uaddr (FUTEX_WAKE) */
+int futex (int *uaddr, int op, int val)
+{
+	switch (op)
+	{
+	case FUTEX_WAIT:
+		return futex_wait(uaddr, val);
+	case FUTEX_WAKE:
+		return futex_wake(uaddr, val);
+	default:
+		return -1;
 	}
 }
+/* Starts a Thread sharing this Process's Memory and Files, running entry(arg0, arg1) on a User Stack of its own */
+tid_t thread_create_call (void *entry, void *arg0, void *arg1)
+{
+	return process_thread_create(entry, arg0, arg1);
+}
+/* Waits for a Thread this Thread created to exit() and returns its Status */
+int thread_join_call (tid_t tid)
+{
+	return process_thread_join(tid);
+}
 void seek (int fd, unsigned position)
 {
 	struct file *f;
@@ -202,7 +516,8 @@ void seek (int fd, unsigned position)
 
 	f = process_get_file(fd);			// Search the File Object as use fd
 
-	file_seek(f, position);				// seek
+	if (f)						// Pipes and the Console have no position
+		file_seek(f, position);			// seek
 
 	lock_release(&filesys_lock);			// Unlock
 }
@@ -215,7 +530,7 @@ unsigned tell (int fd)
 	
 	f = process_get_file(fd);			// Search the File Object as use fd
 
-	off_pos = file_tell(f);				// Get Off Position
+	off_pos = f ? (unsigned) file_tell(f) : (unsigned) -1;	// Get Off Position
 
 	lock_release(&filesys_lock);			// Unlock
 
@@ -223,162 +538,358 @@ unsigned tell (int fd)
 }
 void close (int fd)
 {
+	lock_acquire(&filesys_lock);			// Lock
+
 	process_close_file(fd);
+
+	lock_release(&filesys_lock);			// Unlock
+}
+int64_t monotime (void)
+{
+	return timer_nsec();				// TSC-based, so no lock needed
 }
+int dup (int fd)
+{
+	int new_fd;
+
+	lock_acquire(&filesys_lock);			// Lock
+
+	new_fd = fd_dup(&thread_current()->proc->fds, fd);	// Shares fd's File Object and Position
 
-struct vm_entry *check_address (void *addr, void* esp)
+	lock_release(&filesys_lock);			// Unlock
+
+	return new_fd;
+}
+int dup2 (int old_fd, int new_fd)
 {
-	//struct vm_entry *vme;
-	uint32_t address = (uint32_t)addr;
+	lock_acquire(&filesys_lock);			// Lock
 
-	if (!(0x8048000 < address && address < 0xc0000000))
-	{
-		exit(-1);
-	}
+	new_fd = fd_dup2(&thread_current()->proc->fds, old_fd, new_fd);	// Closes new_fd's File first, if any
 
-	// Check the vme->is_loaded, and mapping
-	/*vme = find_vme(addr);
-	if (!vme->is_loaded)
-	{
-		handle_mm_fault(vme);
-	}*/
+	lock_release(&filesys_lock);			// Unlock
 
-	return find_vme(addr);
+	return new_fd;
 }
-void check_valid_buffer (void *buffer, unsigned size, void *esp, bool to_write)
+/* Marks fd to be closed in, or (CLOSE_ON_EXEC false) inherited by, the Processes exec() runs */
+bool set_cloexec (int fd, bool close_on_exec)
 {
-	int i, pages;
-	struct vm_entry *vme_start = check_address(buffer, esp);
-	struct vm_entry *vme_end = check_address(buffer+size, esp);
-	struct vm_entry *vme;
+	bool ok;
 
-	pages = ((int)(vme_start->vaddr - vme_end->vaddr) / PGSIZE) + 1;
-	for (i = 0; i<pages; i++)
-	{
-		vme = check_address(buffer+(PGSIZE*i), esp);
+	lock_acquire(&filesys_lock);			// Lock
 
-		if (vme == NULL || !vme->writable)
-		{
-			exit(-1);
-		}
-	}
+	ok = fd_set_cloexec(&thread_current()->proc->fds, fd, close_on_exec);
+
+	lock_release(&filesys_lock);			// Unlock
+
+	return ok;
 }
-void check_valid_string (const void *str, void *esp)
+
+/**********************************************************************************/
+
+/****************************** System Call Dispatch ******************************/
+/* Kinds of system call arguments, which say how the dispatcher validates them */
+enum arg_kind
 {
-	int i, pages;
-	struct vm_entry *vme_start = check_address(str, esp);
-	struct vm_entry *vme_end = check_address(str+strlen((char*)str), esp);
-	struct vm_entry *vme;
+	ARG_INT,					// Plain value
+	ARG_STR,					// Null-terminated string, copied into the kernel
+	ARG_IN,						// Buffer the kernel reads; its size is the next argument
+	ARG_OUT,					// Buffer the kernel writes; its size is the next argument
+	ARG_VEC,					// Array of struct iovec; its length is the next argument
+	ARG_PTR						// Fixed-size object the kernel reads or writes; its size is in the table
+};
 
-	pages = ((int)(vme_start->vaddr - vme_end->vaddr) / PGSIZE) + 1;
-	for (i = 0; i<pages; i++)
-	{
-		vme = check_address(str+(PGSIZE*i), esp);
+#define SYSCALL_MAX_ARGS 4
 
-		if (vme == NULL)
-		{
-			exit(-1);
-		}
-	}
+/* Handler for one system call: ARG holds its copied-in, validated arguments; any result goes in F */
+typedef void syscall_func (struct intr_frame *f, uint32_t *arg);
+
+/* A system call's handler, number of arguments, and argument kinds */
+struct syscall
+{
+	syscall_func *func;
+	int arity;
+	enum arg_kind kind[SYSCALL_MAX_ARGS];
+	size_t ptr_size;				// Bytes an ARG_PTR argument points to
+};
+
+static void sys_halt (struct intr_frame *f UNUSED, uint32_t *arg UNUSED)
+{
+	halt();
+}
+static void sys_exit (struct intr_frame *f UNUSED, uint32_t *arg)
+{
+	exit(arg[0]);
+}
+static void sys_exec (struct intr_frame *f, uint32_t *arg)
+{
+	f->eax = exec((const char *) arg[0]);
+}
+static void sys_wait (struct intr_frame *f, uint32_t *arg)
+{
+	f->eax = wait(arg[0]);
+}
+static void sys_create (struct intr_frame *f, uint32_t *arg)
+{
+	f->eax = create((const char *) arg[0], arg[1]);
+}
+static void sys_remove (struct intr_frame *f, uint32_t *arg)
+{
+	f->eax = remove((const char *) arg[0]);
+}
+static void sys_open (struct intr_frame *f, uint32_t *arg)
+{
+	f->eax = open((const char *) arg[0]);
+}
+static void sys_filesize (struct intr_frame *f, uint32_t *arg)
+{
+	f->eax = filesize(arg[0]);
+}
+static void sys_read (struct intr_frame *f, uint32_t *arg)
+{
+	f->eax = read(arg[0], (void *) arg[1], arg[2]);
+}
+static void sys_write (struct intr_frame *f, uint32_t *arg)
+{
+	f->eax = write(arg[0], (void *) arg[1], arg[2]);
 }
-void get_argument (void *esp, int *arg, int count)
+static void sys_seek (struct intr_frame *f UNUSED, uint32_t *arg)
 {
+	seek(arg[0], arg[1]);
+}
+static void sys_tell (struct intr_frame *f, uint32_t *arg)
+{
+	f->eax = tell(arg[0]);
+}
+static void sys_close (struct intr_frame *f UNUSED, uint32_t *arg)
+{
+	close(arg[0]);
+}
+static void sys_monotime (struct intr_frame *f, uint32_t *arg UNUSED)
+{
+	int64_t ns = monotime();
+
+	f->eax = (uint32_t) ns;				// 64-bit result in edx:eax
+	f->edx = (uint32_t) (ns >> 32);
+}
+static void sys_dup (struct intr_frame *f, uint32_t *arg)
+{
+	f->eax = dup(arg[0]);
+}
+static void sys_dup2 (struct intr_frame *f, uint32_t *arg)
+{
+	f->eax = dup2(arg[0], arg[1]);
+}
+static void sys_pread (struct intr_frame *f, uint32_t *arg)
+{
+	f->eax = pread(arg[0], (void *) arg[1], arg[2], arg[3]);
+}
+static void sys_pwrite (struct intr_frame *f, uint32_t *arg)
+{
+	f->eax = pwrite(arg[0], (void *) arg[1], arg[2], arg[3]);
+}
+static void sys_readv (struct intr_frame *f, uint32_t *arg)
+{
+	f->eax = readv(arg[0], (const struct iovec *) arg[1], arg[2]);
+}
+static void sys_writev (struct intr_frame *f, uint32_t *arg)
+{
+	f->eax = writev(arg[0], (const struct iovec *) arg[1], arg[2]);
+}
+static void sys_copy_file_range (struct intr_frame *f, uint32_t *arg)
+{
+	f->eax = copy_file_range(arg[0], arg[1], arg[2]);
+}
+static void sys_pipe (struct intr_frame *f, uint32_t *arg)
+{
+	f->eax = pipe((int *) arg[0]);
+}
+static void sys_set_cloexec (struct intr_frame *f, uint32_t *arg)
+{
+	f->eax = set_cloexec(arg[0], arg[1] != 0);
+}
+static void sys_shm_create (struct intr_frame *f, uint32_t *arg)
+{
+	f->eax = shm_create_call((void *) arg[0], arg[1]);
+}
+static void sys_shm_attach (struct intr_frame *f, uint32_t *arg)
+{
+	f->eax = shm_attach_call(arg[0], (void *) arg[1]);
+}
+static void sys_shm_detach (struct intr_frame *f, uint32_t *arg)
+{
+	f->eax = shm_detach_call((void *) arg[0]);
+}
+static void sys_futex (struct intr_frame *f, uint32_t *arg)
+{
+	f->eax = futex((int *) arg[0], arg[1], arg[2]);
+}
+static void sys_thread_create (struct intr_frame *f, uint32_t *arg)
+{
+	f->eax = thread_create_call((void *) arg[0], (void *) arg[1], (void *) arg[2]);
+}
+static void sys_thread_join (struct intr_frame *f, uint32_t *arg)
+{
+	f->eax = thread_join_call(arg[0]);
+}
+
+/* System calls indexed by number; null handlers are unimplemented */
+static const struct syscall syscall_table[] =
+{
+	[SYS_HALT] = {sys_halt, 0, {}},
+	[SYS_EXIT] = {sys_exit, 1, {ARG_INT}},
+	[SYS_EXEC] = {sys_exec, 1, {ARG_STR}},
+	[SYS_WAIT] = {sys_wait, 1, {ARG_INT}},
+	[SYS_CREATE] = {sys_create, 2, {ARG_STR, ARG_INT}},
+	[SYS_REMOVE] = {sys_remove, 1, {ARG_STR}},
+	[SYS_OPEN] = {sys_open, 1, {ARG_STR}},
+	[SYS_FILESIZE] = {sys_filesize, 1, {ARG_INT}},
+	[SYS_READ] = {sys_read, 3, {ARG_INT, ARG_OUT, ARG_INT}},
+	[SYS_WRITE] = {sys_write, 3, {ARG_INT, ARG_IN, ARG_INT}},
+	[SYS_SEEK] = {sys_seek, 2, {ARG_INT, ARG_INT}},
+	[SYS_TELL] = {sys_tell, 1, {ARG_INT}},
+	[SYS_CLOSE] = {sys_close, 1, {ARG_INT}},
+	[SYS_MONOTIME] = {sys_monotime, 0, {}},
+	[SYS_DUP] = {sys_dup, 1, {ARG_INT}},
+	[SYS_DUP2] = {sys_dup2, 2, {ARG_INT, ARG_INT}},
+	[SYS_PREAD] = {sys_pread, 4, {ARG_INT, ARG_OUT, ARG_INT, ARG_INT}},
+	[SYS_PWRITE] = {sys_pwrite, 4, {ARG_INT, ARG_IN, ARG_INT, ARG_INT}},
+	[SYS_READV] = {sys_readv, 3, {ARG_INT, ARG_VEC, ARG_INT}},
+	[SYS_WRITEV] = {sys_writev, 3, {ARG_INT, ARG_VEC, ARG_INT}},
+	[SYS_COPY_FILE_RANGE] = {sys_copy_file_range, 3, {ARG_INT, ARG_INT, ARG_INT}},
+	[SYS_PIPE] = {sys_pipe, 1, {ARG_PTR}, 2 * sizeof (int)},
+	[SYS_SET_CLOEXEC] = {sys_set_cloexec, 2, {ARG_INT, ARG_INT}},
+	[SYS_SHM_CREATE] = {sys_shm_create, 2, {ARG_INT, ARG_INT}},	// Addresses are only mapped, never dereferenced
+	[SYS_SHM_ATTACH] = {sys_shm_attach, 2, {ARG_INT, ARG_INT}},
+	[SYS_SHM_DETACH] = {sys_shm_detach, 1, {ARG_INT}},
+	[SYS_FUTEX] = {sys_futex, 3, {ARG_PTR, ARG_INT, ARG_INT}, sizeof (int)},
+	[SYS_THREAD_CREATE] = {sys_thread_create, 3, {ARG_INT, ARG_INT, ARG_INT}},	// Passed to the new Thread untouched
+	[SYS_THREAD_JOIN] = {sys_thread_join, 1, {ARG_INT}},
+};
+#define SYSCALL_CNT (sizeof syscall_table / sizeof *syscall_table)
+
+/* Checks, once, that the table describes each system call's arguments in a way the dispatcher can follow:
+   a buffer or vector is followed by its size or length, and a fixed-size object has a size */
+static void check_syscall_table (void)
+{
+	const struct syscall *sc;
 	int i;
 
-	for (i = 0; i<count; i++)
+	for (sc = syscall_table; sc < syscall_table + SYSCALL_CNT; sc++)
 	{
-		esp = esp + 4;
-		check_address(esp, esp);
-		arg[i] = *(int*)esp;
+		if (sc->func == NULL)
+			continue;
+		ASSERT (sc->arity <= SYSCALL_MAX_ARGS);
+		for (i = 0; i < sc->arity; i++)
+			switch (sc->kind[i])
+			{
+			case ARG_IN:
+			case ARG_OUT:
+			case ARG_VEC:
+				ASSERT (i + 1 < sc->arity && sc->kind[i + 1] == ARG_INT);
+				break;
+			case ARG_PTR:
+				ASSERT (sc->ptr_size > 0);
+				break;
+			case ARG_INT:
+			case ARG_STR:
+				break;
+			}
 	}
 }
+
+/* Returns true if CNT objects of SIZE bytes each, from user address UADDR on, lie below PHYS_BASE without wrapping around.
+   Only the range is checked: uaccess.c finds out whether the pages are mapped as it copies them */
+static bool user_range_ok (uint32_t uaddr, uint32_t cnt, size_t size)
+{
+	const uint32_t top = (uint32_t) PHYS_BASE;
+
+	if (cnt == 0)
+		return true;
+	return uaddr < top && cnt <= (top - uaddr) / size;
+}
 /**********************************************************************************/
 
 void
 syscall_init (void) 
 {
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
+  sysenter_init ();
+  futex_init ();
   lock_init(&filesys_lock);
+  check_syscall_table ();
 }
 
 static void
-syscall_handler (struct intr_frame *f UNUSED) 
+syscall_handler (struct intr_frame *f) 
 {
-	int syscall_number, arg[MAX_SYSTEMCALL_ARGUMENT];
-	char *ptr;
+	syscall_dispatch(f);
+}
 
-	/* Get Stack Pointer from interrupt frame */
-	void *esp = f->esp;
-	
-	/* Check Stack Pointer Address */
-	check_address(esp, esp);
+/* Carries out the system call described by F, which came in through int $0x30 or sysenter (userprog/sysenter-stub.S).
+   User memory is only touched through userprog/uaccess.c, so nothing is checked page by page in advance: buffers are
+   only checked to lie in user memory, once, here */
+void
+syscall_dispatch (struct intr_frame *f)
+{
+	const uint32_t *esp = f->esp;			// Number, then arguments, on the user stack
+	uint32_t arg[SYSCALL_MAX_ARGS];
+	const struct syscall *sc;
+	uint32_t number;
+	char *strs = NULL;				// Kernel copies of string arguments
+	size_t strs_used = 0;
+	bool ok = true;
+	int i;
+
+	process_check_exit();				// Another Thread ended the Process
+
+	if (!copy_from_user(&number, esp, sizeof number))	// Number first, to learn the arity
+		exit(-1);
+	if (number >= SYSCALL_CNT || syscall_table[number].func == NULL)
+		exit(-1);
+	sc = &syscall_table[number];
 
-	/* Get SysCall Number from User Stack */
-	syscall_number = *(int*)esp;
+	if (!copy_from_user(arg, esp + 1, sc->arity * sizeof *esp))	// One copy for all arguments
+		exit(-1);
 
-	// If 1 < argc : esp + 4 + (argc*4)
-	// else if argc == 1 : esp
-	switch (syscall_number)
+	for (i = 0; ok && i < sc->arity; i++)
 	{
-	case SYS_HALT:
-		halt();
-		break;
-	case SYS_EXIT:
-		get_argument(esp, arg, 1);
-		exit(arg[0]);
-		break;
-	case SYS_EXEC:
-		get_argument(esp, arg, 1);
-		check_valid_string((void*)arg[0], esp);
-		f->eax = exec((const char *)arg[0]);
-		break;
-	case SYS_WAIT:
-		get_argument(esp, arg, 1);
-		f->eax = wait(arg[0]);
-		break;
-	case SYS_CREATE:
-		get_argument(esp+12, arg, 2);
-		check_valid_string((void*)arg[0], esp);
-		f->eax = create(arg[0], arg[1]);
-		break;
-	case SYS_REMOVE:
-		get_argument(esp, arg, 1);
-		check_valid_string((void*)arg[0], esp);
-		f->eax = remove(arg[0]);
-		break;
-	case SYS_OPEN:
-		get_argument(esp, arg, 1);
-		check_valid_string((void*)arg[0], esp);
-		f->eax = open(arg[0]);
-		break;
-	case SYS_FILESIZE:
-		get_argument(esp, arg, 1);
-		f->eax = filesize(arg[0]);
-		break;
-	case SYS_READ:
-		get_argument(esp+16, arg, 3);
-		check_valid_buffer((void*)arg[1], arg[2], esp, true);
-		f->eax = read(arg[0], arg[1], arg[2]);
-		break;
-	case SYS_WRITE:
-		get_argument(esp+16, arg, 3);
-		check_valid_string((void*)arg[1], esp);
-		f->eax = write(arg[0], arg[1], arg[2]);
-		break;
-	case SYS_SEEK:
-		get_argument(esp+12, arg, 2);
-		seek(arg[0], arg[1]);
-		break;
-	case SYS_TELL:
-		get_argument(esp, arg, 1);
-		f->eax = tell(arg[0]);
-		break;
-	case SYS_CLOSE:
-		get_argument(esp, arg, 1);
-		close(arg[0]);
-		break;
-	default:
-		thread_exit();
-		break;
+		switch (sc->kind[i])
+		{
+		case ARG_STR:				// Handlers see only the kernel copy
+			if (strs == NULL && (strs = palloc_get_page(0)) == NULL)
+				exit(-1);
+			ok = copy_string_from_user(strs + strs_used, (const char *) arg[i], PGSIZE - strs_used);
+			if (ok)
+			{
+				arg[i] = (uint32_t) (strs + strs_used);
+				strs_used += strlen(strs + strs_used) + 1;
+			}
+			break;
+		case ARG_IN:				// Sizes were paired with buffers by check_syscall_table()
+		case ARG_OUT:
+			ok = user_range_ok(arg[i], arg[i + 1], 1);
+			break;
+		case ARG_VEC:				// A negative length is the handler's to reject
+			ok = (int) arg[i + 1] < 0 || user_range_ok(arg[i], arg[i + 1], sizeof (struct iovec));
+			break;
+		case ARG_PTR:
+			ok = user_range_ok(arg[i], 1, sc->ptr_size);
+			break;
+		case ARG_INT:
+			break;
+		}
+	}
+	if (!ok)
+	{
+		if (strs != NULL)
+			palloc_free_page(strs);
+		exit(-1);
 	}
+
+	sc->func(f, arg);
+
+	if (strs != NULL)
+		palloc_free_page(strs);
+
+	process_check_exit();				// It may have ended while we were in here
 }
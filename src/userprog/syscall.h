@@ -1,7 +1,10 @@
 #ifndef USERPROG_SYSCALL_H
 #define USERPROG_SYSCALL_H
 
+struct intr_frame;
+
 void syscall_init (void);
+void syscall_dispatch (struct intr_frame *);
 
 struct lock filesys_lock;
 
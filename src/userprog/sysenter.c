@@ -0,0 +1,67 @@
+#include "userprog/sysenter.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/loader.h"
+#include "userprog/tss.h"
+
+/* Model-specific registers that SYSENTER loads CS, ESP, and EIP
+   from.  SS is CS + 8; SYSEXIT uses CS + 16 and CS + 24, which in
+   our GDT are the user code and data segments. */
+#define MSR_SYSENTER_CS 0x174
+#define MSR_SYSENTER_ESP 0x175
+#define MSR_SYSENTER_EIP 0x176
+
+/* CPUID leaf 1 EDX bit: SYSENTER and SYSEXIT are supported. */
+#define CPUID_SEP (1u << 11)
+
+/* Stack that SYSENTER switches to.  sysenter_entry leaves it at
+   once for the running thread's kernel stack, but a user program
+   that single-steps into SYSENTER takes a debug trap before
+   sysenter_entry's first instruction, and that trap's frame is
+   pushed here (see debug() in exception.c). */
+static uint32_t entry_stack[256];
+
+/* Address of the TSS's esp0, from which sysenter_entry loads the
+   top of the running thread's kernel stack. */
+void **sysenter_esp0;
+
+/* Returns true if the CPU supports SYSENTER and SYSEXIT. */
+static bool
+cpu_has_sep (void) 
+{
+  uint32_t eax = 1, ebx, ecx, edx;
+  asm ("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+  return (edx & CPUID_SEP) != 0;
+}
+
+/* Writes VALUE to model-specific register MSR. */
+static void
+write_msr (uint32_t msr, uint64_t value) 
+{
+  asm volatile ("wrmsr" : : "c" (msr), "A" (value));
+}
+
+/* Lets user programs make system calls with SYSENTER, if the CPU
+   supports it, as a faster alternative to int $0x30.  User
+   programs check CPUID for the same feature bit to decide which
+   to use.  Must be called after tss_init(). */
+void
+sysenter_init (void) 
+{
+  if (!cpu_has_sep ())
+    {
+      printf ("sysenter: not supported, using int $0x30 only\n");
+      return;
+    }
+
+  /* SYSENTER can only load a fixed ESP, so give it a small stack
+     of its own and let sysenter_entry load ESP from the TSS's
+     esp0, which tss_update() keeps pointing to the top of the
+     running thread's kernel stack. */
+  sysenter_esp0 = tss_esp0 ();
+  write_msr (MSR_SYSENTER_CS, SEL_KCSEG);
+  write_msr (MSR_SYSENTER_ESP,
+             (uint32_t) (entry_stack + sizeof entry_stack / sizeof *entry_stack));
+  write_msr (MSR_SYSENTER_EIP, (uint32_t) sysenter_entry);
+}
@@ -0,0 +1,7 @@
+#ifndef USERPROG_SYSENTER_H
+#define USERPROG_SYSENTER_H
+
+void sysenter_init (void);
+void sysenter_entry (void);
+
+#endif /* userprog/sysenter.h */
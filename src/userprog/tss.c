@@ -96,6 +96,16 @@ tss_get (void)
   return tss;
 }
 
+/* Returns the address of the TSS's ring 0 stack pointer, which
+   always points to the top of the running thread's kernel
+   stack. */
+void **
+tss_esp0 (void) 
+{
+  ASSERT (tss != NULL);
+  return &tss->esp0;
+}
+
 /* Sets the ring 0 stack pointer in the TSS to point to the end
    of the thread stack. */
 void
@@ -0,0 +1,126 @@
+#include "userprog/uaccess.h"
+#include <stdint.h>
+#include "threads/interrupt.h"
+#include "threads/vaddr.h"
+
+/* Access to user memory that is checked by the MMU instead of in
+   advance.
+
+   Each instruction below that may touch a user address has an
+   entry in the __ex_table section that gives the address of the
+   instruction and of a "fixup" at which to continue if it faults.
+   When page_fault() cannot bring in the page that a kernel-mode
+   fault refers to, it calls uaccess_fixup(), which resumes the
+   faulting routine at its fixup, so that the routine returns
+   false instead of the process being killed on the spot.  A user
+   buffer thus costs nothing to validate beyond a bounds check,
+   however large it is. */
+
+/* An exception table entry. */
+struct ex_entry
+  {
+    uintptr_t insn;             /* Instruction that may fault. */
+    uintptr_t fixup;            /* Where to continue if it does. */
+  };
+
+/* Bounds of the exception table, from kernel.lds.S. */
+extern const struct ex_entry __start_ex_table[], __stop_ex_table[];
+
+/* Returns true if the SIZE bytes at UADDR lie entirely below
+   PHYS_BASE. */
+static bool
+is_user_range (const void *uaddr, size_t size) 
+{
+  return ((uintptr_t) uaddr <= (uintptr_t) PHYS_BASE
+          && size <= (uintptr_t) PHYS_BASE - (uintptr_t) uaddr);
+}
+
+/* Copies SIZE bytes from SRC to DST, either of which may be in
+   user memory, with a single string move.  Returns true if
+   successful, false if it faulted partway. */
+static bool
+checked_copy (void *dst, const void *src, size_t size) 
+{
+  int ok = 0;
+
+  asm volatile ("1: rep movsb\n"
+                "   movl $1, %0\n"
+                "2:\n"
+                ".pushsection __ex_table, \"a\"\n"
+                "   .long 1b, 2b\n"
+                ".popsection"
+                : "+a" (ok), "+D" (dst), "+S" (src), "+c" (size)
+                : : "memory");
+  return ok;
+}
+
+/* Copies SIZE bytes from user address USRC to kernel buffer DST.
+   Returns true if successful, false if USRC is not a user
+   address or any of its pages cannot be read. */
+bool
+copy_from_user (void *dst, const void *usrc, size_t size) 
+{
+  return is_user_range (usrc, size) && checked_copy (dst, usrc, size);
+}
+
+/* Copies SIZE bytes from kernel buffer SRC to user address UDST.
+   Returns true if successful, false if UDST is not a user
+   address or any of its pages cannot be written, in which case
+   some prefix of it may have been written. */
+bool
+copy_to_user (void *udst, const void *src, size_t size) 
+{
+  return is_user_range (udst, size) && checked_copy (udst, src, size);
+}
+
+/* Copies the null-terminated string at user address USRC,
+   including the null terminator, to kernel buffer DST, which
+   has room for SIZE bytes.  Returns true if successful, false if
+   the string does not fit, runs out of user memory, or cannot be
+   read. */
+bool
+copy_string_from_user (char *dst, const char *usrc, size_t size) 
+{
+  size_t limit;
+  int ok = 0;
+
+  if (!is_user_range (usrc, 0))
+    return false;
+  limit = (uintptr_t) PHYS_BASE - (uintptr_t) usrc;
+  if (limit > size)
+    limit = size;
+  if (limit == 0)
+    return false;
+
+  asm volatile ("1: lodsb\n"
+                "   stosb\n"
+                "   testb %%al, %%al\n"
+                "   jz 3f\n"
+                "   loop 1b\n"
+                "   jmp 2f\n"
+                "3: movl $1, %0\n"
+                "2:\n"
+                ".pushsection __ex_table, \"a\"\n"
+                "   .long 1b, 2b\n"
+                ".popsection"
+                : "+d" (ok), "+D" (dst), "+S" (usrc), "+c" (limit)
+                : : "eax", "cc", "memory");
+  return ok;
+}
+
+/* If the page fault described by F happened in one of the
+   routines above, arranges for it to return failure when F is
+   resumed and returns true.  Otherwise returns false. */
+bool
+uaccess_fixup (struct intr_frame *f) 
+{
+  const struct ex_entry *e;
+
+  for (e = __start_ex_table; e < __stop_ex_table; e++)
+    if (e->insn == (uintptr_t) f->eip)
+      {
+        f->eip = (void (*) (void)) e->fixup;
+        return true;
+      }
+  return false;
+}
@@ -1,4 +1,6 @@
 #include "vm/page.h"
+#include "userprog/process.h"
+#include "vm/shm.h"
 
 void vm_init (struct hash *vm)
 {
@@ -18,11 +20,12 @@ static bool vm_less_func (const struct hash_elem *a, const struct hash_elem *b,
 {
 	return hash_entry(a, struct vm_entry, elem)->vaddr < hash_entry(b, struct vm_entry, elem)->vaddr;
 }
-static void vm_destroy_func (struct hash_elem *e, void *aux)
+/* Frees VME and its page, if loaded.  Shared pages stay with their segment */
+static void free_vme (struct vm_entry *vme)
 {
-	struct vm_entry *vme = hash_entry(e, struct vm_entry, elem);
-
-	if (vme->is_loaded)
+	if (vme->type == VM_SHM)
+		shm_unmap(vme);					// The frame belongs to the segment, not to us
+	else if (vme->is_loaded)
 	{
 		//void *kpage = pagedir_get_page(thread_current()->pagedir, vme->vaddr);
 		palloc_free_page(pagedir_get_page(thread_current()->pagedir, vme->vaddr));
@@ -31,6 +34,10 @@ static void vm_destroy_func (struct hash_elem *e, void *aux)
 
 	free(vme);
 }
+static void vm_destroy_func (struct hash_elem *e, void *aux)
+{
+	free_vme(hash_entry(e, struct vm_entry, elem));
+}
 struct vm_entry *find_vme (void *vaddr)
 {
 	struct vm_entry vm;
@@ -38,7 +45,7 @@ struct vm_entry *find_vme (void *vaddr)
 	
 	vm.vaddr = pg_round_down(vaddr);
 
-	h = hash_find(&thread_current()->vm, &vm.elem);
+	h = hash_find(&thread_current()->proc->vm, &vm.elem);
 
 	if (h == NULL)
 	{
@@ -47,6 +54,12 @@ struct vm_entry *find_vme (void *vaddr)
 
 	return hash_entry(h, struct vm_entry, elem);
 }
+/* Unmaps VME from the current process and frees it */
+void vm_remove (struct vm_entry *vme)
+{
+	delete_vme(&thread_current()->proc->vm, vme);
+	free_vme(vme);
+}
 bool insert_vme (struct hash *vm, struct vm_entry *vme)
 {
 	return (hash_insert(vm, &vme->elem) == NULL) ? true : false;
@@ -10,15 +10,17 @@
 #define VM_BIN 0
 #define VM_FILE 1
 #define VM_ANON 2
+#define VM_SHM 3
 
 struct vm_entry
 {
-	uint8_t type;			// VM_BIN, VM_FILE, VM_ANON
+	uint8_t type;			// VM_BIN, VM_FILE, VM_ANON, VM_SHM
 	void *vaddr;			// virtual address that is operated by vm_entry
 	bool writable;			// write flag
 	bool is_loaded;			// flag that inform whether loaded to physical memory
 	bool pinned;
 	struct file *file;		// file mapped with vaddr
+	struct shm *shm;		// shared segment mapped with vaddr (VM_SHM, page given by offset)
 	struct list_elem mmap_elem;	// mmap list element
 	size_t offset;			// offset to read in file
 	size_t read_bytes;		// read_bytes (often it's 4KB)
@@ -33,6 +35,7 @@ static unsigned vm_hash_func (const struct hash_elem *e, void *aux);
 static bool vm_less_func (const struct hash_elem *a, const struct hash_elem *b, void *aux);
 static void vm_destroy_func (struct hash_elem *e, void *aux);
 struct vm_entry *find_vme (void *vaddr);
+void vm_remove (struct vm_entry *vme);
 bool insert_vme (struct hash *vm, struct vm_entry *vme);
 bool delete_vme (struct hash *vm, struct vm_entry *vme);
 
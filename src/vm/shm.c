@@ -0,0 +1,225 @@
+#include "vm/shm.h"
+#include <list.h>
+#include <round.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
+#include "vm/page.h"
+
+/* Shared anonymous memory.
+   A segment is a set of frames that every process attached to it maps, one VM_SHM vm_entry per page,
+   so data written by one process is seen by the others with no copying.
+   Each vm_entry holds a reference to its segment; the segment and its frames are freed when the last one goes.
+   Frames are allocated, zeroed, on the first fault on the page in any process.
+   A process's vm_lock is taken before shm_lock */
+
+struct shm
+{
+	int id;					// Identifier that shm_attach() takes
+	size_t page_cnt;			// Number of pages
+	void **frames;				// Kernel address of each page's frame, or NULL until first touched
+	int ref_cnt;				// Number of vm_entries that map it
+	struct list_elem elem;			// Element in shm_list
+};
+
+static struct list shm_list;			// All segments
+static struct lock shm_lock;			// Protects shm_list and every segment
+static int next_id;
+
+void shm_init (void)
+{
+	list_init(&shm_list);
+	lock_init(&shm_lock);
+	next_id = 0;
+}
+
+/* Returns the segment with identifier ID, or NULL.  shm_lock must be held */
+static struct shm *lookup (int id)
+{
+	struct list_elem *e;
+
+	for (e = list_begin(&shm_list); e != list_end(&shm_list); e = list_next(e))
+	{
+		struct shm *s = list_entry(e, struct shm, elem);
+		if (s->id == id)
+			return s;
+	}
+	return NULL;
+}
+
+/* Drops one reference to S, freeing it and its frames with the last.  shm_lock must be held */
+static void put (struct shm *s)
+{
+	size_t i;
+
+	if (--s->ref_cnt > 0)
+		return;
+
+	list_remove(&s->elem);
+	for (i = 0; i < s->page_cnt; i++)
+		palloc_free_page(s->frames[i]);
+	free(s->frames);
+	free(s);
+}
+
+/* Maps S at user address ADDR in the current process, adding a reference per page.
+   Fails, mapping nothing, unless ADDR is page-aligned and the whole range is unused user memory.
+   The process's vm_lock and shm_lock must be held */
+static bool map (struct shm *s, void *addr)
+{
+	struct process *proc = thread_current()->proc;
+	uint8_t *upage = addr;
+	size_t i;
+
+	if (upage == NULL || pg_ofs(upage) != 0
+	    || s->page_cnt > (size_t) ((uint8_t *) PHYS_BASE - upage) / PGSIZE)
+		return false;
+	for (i = 0; i < s->page_cnt; i++)
+		if (find_vme(upage + i * PGSIZE) != NULL)		// Already mapped
+			return false;
+
+	for (i = 0; i < s->page_cnt; i++)
+	{
+		struct vm_entry *vme = calloc(1, sizeof *vme);
+
+		if (vme == NULL)
+		{
+			while (i-- > 0)					// Undo the pages mapped so far
+			{
+				vme = find_vme(upage + i * PGSIZE);	// Not vm_remove(): it takes shm_lock, which we hold
+				ASSERT(!vme->is_loaded);		// Faults wait for our vm_lock
+				delete_vme(&proc->vm, vme);
+				free(vme);
+				s->ref_cnt--;				// As it was: shm_create() frees a new S itself
+			}
+			return false;
+		}
+		vme->type = VM_SHM;
+		vme->vaddr = upage + i * PGSIZE;
+		vme->writable = true;
+		vme->is_loaded = false;
+		vme->shm = s;
+		vme->offset = i * PGSIZE;
+		insert_vme(&proc->vm, vme);
+		s->ref_cnt++;
+	}
+	return true;
+}
+
+/* Creates a zeroed segment of SIZE bytes, rounded up to whole pages, and attaches it at ADDR.
+   Returns its identifier, for other processes to pass to shm_attach(), or -1 on failure */
+int shm_create (void *addr, size_t size)
+{
+	struct process *proc = thread_current()->proc;
+	struct shm *s;
+	int id = -1;
+
+	if (size == 0)
+		return -1;
+
+	s = malloc(sizeof *s);
+	if (s == NULL)
+		return -1;
+	s->page_cnt = DIV_ROUND_UP(size, PGSIZE);
+	s->frames = calloc(s->page_cnt, sizeof *s->frames);
+	if (s->frames == NULL)
+	{
+		free(s);
+		return -1;
+	}
+	s->ref_cnt = 0;
+
+	lock_acquire(&proc->vm_lock);
+	lock_acquire(&shm_lock);
+	s->id = next_id++;
+	list_push_back(&shm_list, &s->elem);
+	if (map(s, addr))
+		id = s->id;
+	else
+	{
+		s->ref_cnt = 1;					// Let put() free it
+		put(s);
+	}
+	lock_release(&shm_lock);
+	lock_release(&proc->vm_lock);
+
+	return id;
+}
+
+/* Attaches the segment with identifier ID at ADDR in the current process */
+bool shm_attach (int id, void *addr)
+{
+	struct process *proc = thread_current()->proc;
+	struct shm *s;
+	bool success = false;
+
+	lock_acquire(&proc->vm_lock);
+	lock_acquire(&shm_lock);
+	s = lookup(id);
+	if (s != NULL)
+		success = map(s, addr);
+	lock_release(&shm_lock);
+	lock_release(&proc->vm_lock);
+
+	return success;
+}
+
+/* Detaches the segment attached at ADDR in the current process */
+bool shm_detach (void *addr)
+{
+	struct process *proc = thread_current()->proc;
+	struct vm_entry *vme;
+	size_t i, page_cnt;
+
+	lock_acquire(&proc->vm_lock);
+	vme = find_vme(addr);
+	if (vme == NULL || vme->type != VM_SHM || vme->vaddr != addr || vme->offset != 0)
+	{
+		lock_release(&proc->vm_lock);
+		return false;					// Not the start of a segment
+	}
+
+	page_cnt = vme->shm->page_cnt;				// The segment may go with the last page
+	for (i = 0; i < page_cnt; i++)
+		vm_remove(find_vme((uint8_t *) addr + i * PGSIZE));
+	lock_release(&proc->vm_lock);
+	return true;
+}
+
+/* Maps VME's page of its segment, allocating the frame on first touch by any process */
+bool shm_fault (struct vm_entry *vme)
+{
+	struct shm *s = vme->shm;
+	size_t idx = vme->offset / PGSIZE;
+	void *kaddr;
+
+	lock_acquire(&shm_lock);
+	kaddr = s->frames[idx];
+	if (kaddr == NULL)
+		kaddr = s->frames[idx] = palloc_get_page(PAL_USER | PAL_ZERO);
+	lock_release(&shm_lock);
+
+	if (kaddr == NULL)
+		return false;
+	vme->is_loaded = pagedir_set_page(thread_current()->pagedir, vme->vaddr, kaddr, vme->writable);
+	return vme->is_loaded;
+}
+
+/* Unmaps VME's page from the current process and drops its reference to the segment, but leaves the frame to the segment */
+void shm_unmap (struct vm_entry *vme)
+{
+	if (vme->is_loaded)
+	{
+		pagedir_clear_page(thread_current()->pagedir, vme->vaddr);
+		vme->is_loaded = false;
+	}
+
+	lock_acquire(&shm_lock);
+	put(vme->shm);
+	lock_release(&shm_lock);
+}
@@ -0,0 +1,16 @@
+#ifndef SHM_H
+#define SHM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct vm_entry;
+
+void shm_init (void);
+int shm_create (void *addr, size_t size);
+bool shm_attach (int id, void *addr);
+bool shm_detach (void *addr);
+bool shm_fault (struct vm_entry *vme);
+void shm_unmap (struct vm_entry *vme);
+
+#endif